@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "memory.h"
 
 #define _AL(x) GLUE(_Arraylist_,x)
 #define AL(x) GLUE(Arraylist_,x)
@@ -7,9 +8,10 @@ typedef struct AL(T) {
     T *array;
     usize cap;
     usize len;
+    Alloc alloc;
 } AL(T);
 
-AL(T) GLUE(AL(T),_Init)(usize cap);
+AL(T) GLUE(AL(T),_Init)(Alloc alloc, usize cap);
 void GLUE(AL(T),_Insert)(AL(T) *al, T val, usize i);
 void GLUE(AL(T),_Remove)(AL(T) *al, usize i);
 void GLUE(AL(T),_Push)(AL(T) *al, T val);
@@ -24,10 +26,11 @@ void GLUE(AL(T),_Reserve)(AL(T) *al, usize len);
 #include <stdlib.h>
 #include <string.h>
 
-AL(T) GLUE(AL(T),_Init)(usize cap) {
+AL(T) GLUE(AL(T),_Init)(Alloc alloc, usize cap) {
     AL(T) al = (AL(T)){
-        .array = malloc(cap*sizeof(T)),
+        .array = memAlloc(alloc, cap*sizeof(T)),
         .cap = cap,
+        .alloc = alloc,
     };
 
     memset(al.array, 0, cap*sizeof(T));
@@ -52,7 +55,7 @@ void GLUE(AL(T),_Remove)(AL(T) *al, usize i) {
 
     memmove(al->array+i,
             al->array+i+1,
-            (al->len-i)*sizeof(T));
+            (al->len-i-1)*sizeof(T));
 
     al->len--;
 }
@@ -69,15 +72,18 @@ T GLUE(AL(T),_Pop)(AL(T) *al) {
 }
 
 void GLUE(AL(T),_Deinit)(AL(T) *al) {
-    free(al->array);
+    memFree(al->alloc, al->array);
+    al->array = NULL;
+    al->cap = al->len = 0;
 }
 
 void GLUE(AL(T),_Grow)(AL(T) *al) {
-    T *newAl = malloc(al->cap*2*sizeof(T));
+    usize cap = al->cap ? al->cap*2 : 8;
+    T *newAl = memAlloc(al->alloc, cap*sizeof(T));
     memmove(newAl, al->array, al->len*sizeof(T));
-    free(al->array);
+    memFree(al->alloc, al->array);
     al->array = newAl;
-    al->cap *= 2;
+    al->cap = cap;
 }
 
 void GLUE(AL(T),_Reserve)(AL(T) *al, usize len) {
@@ -1,4 +1,6 @@
 #include "buffer.h"
+#include "fontcache.h"
+#include "ingest.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,30 +18,56 @@ Buffer InitBuffer(usize cap) {
         .textLineSpacing = 2,
         .textSpacing = 3,
 
-        .buffer = Arraylist_s32_Init(cap),
+        .buffer = Arraylist_s32_Init(TagAlloc(MemTag_Text), cap),
         .cursorPos = 0,
         .cursorLine = 0,
         
-        .tempAlloc = NewArenaAlloc(SysAlloc, TEMP_ARENA_SIZE),
+        .tempAlloc = NewArenaAlloc(TagAlloc(MemTag_Temp), TEMP_ARENA_SIZE),
 
-        .path = Arraylist_char_Init(8),
+        .path = Arraylist_char_Init(TagAlloc(MemTag_UI), 8),
 
-        .renderTex = LoadRenderTexture(GetScreenWidth(), GetScreenHeight()),
+        .viewport = {0, 0, GetScreenWidth(), GetScreenHeight()},
 
-        .msg = Arraylist_char_Init(8),
+        .msg = Arraylist_char_Init(TagAlloc(MemTag_UI), 8),
 
-        .lines = Arraylist_Line_Init(8),
+        .lines = Arraylist_Line_Init(TagAlloc(MemTag_Lines), 8),
+        .meshes = Arraylist_LineMesh_Init(TagAlloc(MemTag_UI), 8),
+        .folds = Arraylist_Fold_Init(TagAlloc(MemTag_Lines), 8),
+
+        .edit = {.old = Arraylist_s32_Init(TagAlloc(MemTag_Index), 64)},
+        .completion = {.items = Arraylist_char_Init(TagAlloc(MemTag_UI), 64)},
+
+        .dirty = BDirty_All,
+        .status = {
+            .msg = Arraylist_char_Init(TagAlloc(MemTag_UI), 8),
+            .path = Arraylist_char_Init(TagAlloc(MemTag_UI), 8),
+            .lineCol = Arraylist_char_Init(TagAlloc(MemTag_UI), 8),
+        },
     };
 
+    Arraylist_Line_Push(&b.lines, (Line){0, 0});
+    LineCacheReset(&b.meshes, b.lines.len);
+
     BufferLoadFont(&b, 20);
 
     return b;
 }
 
 void DeinitBuffer(Buffer *buffer) {
-    UnloadFont(buffer->font);
+    BufferUnloadFont(buffer);
     UnloadShader(buffer->shader);
-    DeleteArenaAlloc(SysAlloc, buffer->tempAlloc);
+    Arraylist_s32_Deinit(&buffer->buffer);
+    Arraylist_char_Deinit(&buffer->path);
+    Arraylist_char_Deinit(&buffer->msg);
+    Arraylist_Line_Deinit(&buffer->lines);
+    LineCacheDeinit(&buffer->meshes);
+    Arraylist_Fold_Deinit(&buffer->folds);
+    Arraylist_char_Deinit(&buffer->status.msg);
+    Arraylist_char_Deinit(&buffer->status.path);
+    Arraylist_char_Deinit(&buffer->status.lineCol);
+    Arraylist_s32_Deinit(&buffer->edit.old);
+    Arraylist_char_Deinit(&buffer->completion.items);
+    DeleteArenaAlloc(TagAlloc(MemTag_Temp), buffer->tempAlloc);
 }
 
 void RescanBuffer(Buffer *buffer) {
@@ -52,199 +80,329 @@ void RescanBuffer(Buffer *buffer) {
             lineStart = i+1;
         }
     }
+    Arraylist_Line_Push(&buffer->lines, (Line){lineStart, buffer->buffer.len});
 
-    for (usize i = 0; i < buffer->lines.len; ++i) {
-      Line l = buffer->lines.array[i];
-      printf("Lines[%u] { start: %u end: %u }\n", i, l.start, l.end);
-    }
+    LineCacheReset(&buffer->meshes, buffer->lines.len);
+    buffer->folds.len = 0;
+    buffer->dirty |= BDirty_All;
 }
 
 void InsertBufferBlock(Buffer *buffer, u8 *data, usize dataLen) {
+    BufferTouchLines(buffer, buffer->cursorLine, buffer->cursorLine);
+
+    usize newlines = 0;
     for (usize i=0;i<dataLen;) {
         s32 cps;
-        Arraylist_s32_Insert(&buffer->buffer, GetCodepointNext(data+i, &cps), buffer->cursorPos);
+        s32 codepoint = GetCodepointNext(data+i, &cps);
+        Arraylist_s32_Insert(&buffer->buffer, codepoint, buffer->cursorPos);
         buffer->cursorPos++;
+        newlines += codepoint == '\n';
         i+=cps;
     }
 
     RescanBuffer(buffer);
+    // Only the cursor line was split, the lines around it just moved.
+    buffer->cursorLine += newlines;
+    buffer->edit.last += newlines;
 }
 
 void InsertBuffer(Buffer *buffer, s32 codepoint) {
+    BufferTouchLines(buffer, buffer->cursorLine, buffer->cursorLine);
+
     Arraylist_s32_Insert(&buffer->buffer, codepoint, buffer->cursorPos);
 
-    buffer->lines.array[buffer->cursorLine].end++;
+    for (usize i = buffer->cursorLine+1; i < buffer->lines.len; ++i) {
+        buffer->lines.array[i].start++;
+        buffer->lines.array[i].end++;
+    }
+
+    Line *line = buffer->lines.array+buffer->cursorLine;
+    line->end++;
     buffer->cursorPos++;
 
+    LineCacheInvalidate(&buffer->meshes, buffer->cursorLine);
+    buffer->dirty |= BDirty_All;
+
     if (codepoint == '\n') {
-        Arraylist_Line_Push(&buffer->lines,
-                              (Line){.start=buffer->cursorPos, .end=buffer->cursorPos});
+        // Split the line at the cursor.
+        Line next = {.start=buffer->cursorPos, .end=line->end};
+        line->end = buffer->cursorPos-1;
+
+        buffer->cursorLine++;
+        Arraylist_Line_Insert(&buffer->lines, next, buffer->cursorLine);
+        LineCacheInsert(&buffer->meshes, buffer->cursorLine);
+        FoldShift(&buffer->folds, buffer->cursorLine-1, 1, 2);
+        buffer->edit.last++;
     }
-
-    // TODO(m1cha1s): Remove, add a line buffer to keep track of lines and so on.
-    // BufferFixCursorLineCol(buffer); // NOTE(m1cha1s): This takes 99.99% of the time during loading a file!!!
 }
 
 void BackspaceBuffer(Buffer *buffer) {
     if ((!buffer->cursorPos) || (!buffer->buffer.len) || (buffer->cursorPos-1 >= buffer->buffer.len)) return;
 
     if (buffer->buffer.array[buffer->cursorPos-1] == '\n') {
+        BufferTouchLines(buffer, buffer->cursorLine-1, buffer->cursorLine);
+
+        // Join the line with the previous one.
+        buffer->lines.array[buffer->cursorLine-1].end = buffer->lines.array[buffer->cursorLine].end;
+        Arraylist_Line_Remove(&buffer->lines, buffer->cursorLine);
+        LineCacheRemove(&buffer->meshes, buffer->cursorLine);
+        FoldShift(&buffer->folds, buffer->cursorLine-1, 2, 1);
         buffer->cursorLine--;
-        Arraylist_Line_Remove(&buffer->lines, buffer->cursorLine+1);
+        buffer->edit.last--;
+    } else {
+        BufferTouchLines(buffer, buffer->cursorLine, buffer->cursorLine);
     }
 
     buffer->cursorPos--;
 
     Arraylist_s32_Remove(&buffer->buffer, buffer->cursorPos);
 
-    //BufferFixCursorLineCol(buffer);
+    buffer->lines.array[buffer->cursorLine].end--;
+    for (usize i = buffer->cursorLine+1; i < buffer->lines.len; ++i) {
+        buffer->lines.array[i].start--;
+        buffer->lines.array[i].end--;
+    }
+
+    LineCacheInvalidate(&buffer->meshes, buffer->cursorLine);
+    buffer->dirty |= BDirty_All;
 }
 
-void DrawBuffer(Buffer *buffer) {
-    BeginTextureMode(buffer->renderTex);
-    ClearBackground(BLACK);
-    Vector2 textOffset = {0,-buffer->viewLoc};
+// Forward delete, the same as stepping over the character and erasing it.
+void DeleteBuffer(Buffer *buffer) {
+    if (buffer->cursorPos >= buffer->buffer.len) return;
+
+    if (buffer->cursorPos == buffer->lines.array[buffer->cursorLine].end) buffer->cursorLine++;
+    buffer->cursorPos++;
+    BackspaceBuffer(buffer);
+}
+
+static void StatusSet(Arraylist_char *dst, char *text) {
+    dst->len = 0;
+    for (usize i=0;text[i];++i) Arraylist_char_Push(dst, text[i]);
+    Arraylist_char_Push(dst, 0);
+}
 
+static void BufferUpdateStatus(Buffer *buffer) {
+    StatusSet(&buffer->status.lineCol,
+              tfmt(buffer->tempAlloc, "Line: %d Col: %d", buffer->cursorLine+1, buffer->cursorPos+1-buffer->lines.array[buffer->cursorLine].start));
+    StatusSet(&buffer->status.path,
+              tfmt(buffer->tempAlloc, "<%.*s>", buffer->path.len, buffer->path.array));
+    StatusSet(&buffer->status.msg,
+              tfmt(buffer->tempAlloc, "%.*s", buffer->msg.len, buffer->msg.array));
+
+    buffer->status.lineColWidth = MeasureTextEx(buffer->font, buffer->status.lineCol.array, buffer->fontSize, buffer->textSpacing).x;
+    buffer->status.pathWidth = MeasureTextEx(buffer->font, buffer->status.path.array, buffer->fontSize, buffer->textSpacing).x;
+}
+
+// Candidates are listed under the cursor line, starting at the word.
+static void DrawCompletion(Buffer *buffer, f32 cursorX) {
+    CompletionPopup *c = &buffer->completion;
+    Rectangle vp = buffer->viewport;
+    f32 lineHeight = buffer->fontSize + buffer->textLineSpacing;
+
+    f32 prefixWidth = 0;
+    usize cursorCol = buffer->cursorPos - buffer->lines.array[buffer->cursorLine].start;
+    usize prefixLen = min(c->prefixLen, cursorCol);
+    for (usize i = buffer->cursorPos - prefixLen; i < buffer->cursorPos; ++i)
+        prefixWidth += GlyphAdvance(buffer->font, buffer->fontSize, buffer->textSpacing, buffer->buffer.array[i]);
+
+    f32 width = 0;
+    for (usize i = 0; i < c->count; ++i) {
+        f32 w = MeasureTextEx(buffer->font, BufferCompletionItem(buffer, i), buffer->fontSize, buffer->textSpacing).x;
+        width = max(width, w);
+    }
+
+    usize row = FoldRowOfLine(&buffer->folds, buffer->cursorLine);
+    Vector2 pos = {vp.x+cursorX-prefixWidth, vp.y+(row+1)*lineHeight-buffer->viewLoc};
+    // Flip above the cursor when there is no room below.
+    if (pos.y+c->count*lineHeight > vp.y+vp.height-lineHeight) pos.y -= (c->count+1)*lineHeight;
+
+    DrawRectangle(pos.x, pos.y, width+2*buffer->textSpacing, c->count*lineHeight, (Color){40, 40, 40, 240});
+
+    for (usize i = 0; i < c->count; ++i) {
+        Vector2 p = {pos.x+buffer->textSpacing, pos.y+i*lineHeight};
+        if (i == c->selected) DrawRectangle(pos.x, p.y, width+2*buffer->textSpacing, lineHeight, DARKBLUE);
+        DrawTextEx(buffer->font, BufferCompletionItem(buffer, i), p, buffer->fontSize, buffer->textSpacing, WHITE);
+    }
+}
+
+// Open prompt matches, best one right above the status bar.
+static void DrawFileList(Buffer *buffer) {
+    CompletionPopup *c = &buffer->completion;
+    Rectangle vp = buffer->viewport;
+    f32 lineHeight = buffer->fontSize + buffer->textLineSpacing;
+
+    f32 bottom = vp.y+vp.height-(buffer->fontSize + 2*buffer->textLineSpacing);
+    DrawRectangle(vp.x, bottom-c->count*lineHeight, vp.width, c->count*lineHeight, (Color){40, 40, 40, 240});
+
+    for (usize i = 0; i < c->count; ++i) {
+        Vector2 p = {vp.x+2*buffer->textSpacing, bottom-(i+1)*lineHeight};
+        if (i == c->selected) DrawRectangle(vp.x, p.y, vp.width, lineHeight, DARKBLUE);
+        DrawTextEx(buffer->font, BufferCompletionItem(buffer, i), p, buffer->fontSize, buffer->textSpacing, WHITE);
+    }
+}
+
+// Draws the cursor box on the cursor line at y, returns its x offset.
+f32 BufferDrawCursor(Buffer *buffer, f32 y) {
+    Line l = buffer->lines.array[buffer->cursorLine];
     f32 scaleFactor = buffer->fontSize/buffer->font.baseSize;
 
-    // BeginShaderMode(buffer->shader);
-    BeginBlendMode(BLEND_ALPHA);
-    for (usize i=0; i < buffer->buffer.len+1; ++i) {
-        s32 codepoint = 0;
-        s32 index = 0;
+    f32 x = 0;
+    for (usize i = l.start; i < buffer->cursorPos && i < l.end; ++i)
+        x += GlyphAdvance(buffer->font, buffer->fontSize, buffer->textSpacing, buffer->buffer.array[i]);
 
-        if (i < buffer->buffer.len) {
-            codepoint = buffer->buffer.array[i];
-            index = GetGlyphIndex(buffer->font, codepoint);
-        }
+    s32 index = 0;
+    if (buffer->cursorPos < buffer->buffer.len)
+        index = GetGlyphIndex(buffer->font, buffer->buffer.array[buffer->cursorPos]);
 
-        if (buffer->cursorPos == i) {
-            DrawRectangleV(textOffset,
-                           (Vector2){buffer->font.recs[index].width *scaleFactor + buffer->textSpacing,
-                               buffer->fontSize + buffer->textLineSpacing},
-                           PINK);
-        }
+    DrawRectangleV((Vector2){buffer->viewport.x+x, y},
+                   (Vector2){buffer->font.recs[index].width *scaleFactor + buffer->textSpacing,
+                       buffer->fontSize + buffer->textLineSpacing},
+                   PINK);
+    return x;
+}
 
-        if (i >= buffer->buffer.len) continue;
+void BufferDrawLine(Buffer *buffer, usize line, Vector2 origin) {
+    LineMesh *mesh = buffer->meshes.array+line;
 
-        if (codepoint == '\n') {
-            textOffset.y += (buffer->fontSize + buffer->textLineSpacing);
-            textOffset.x = 0.0f;
-        } else {
-            f32 newXOff = 0;
-
-            if (buffer->font.glyphs[index].advanceX == 0)
-                newXOff = ((f32)buffer->font.recs[index].width*scaleFactor + buffer->textSpacing);
-            else
-                newXOff = ((f32)buffer->font.glyphs[index].advanceX*scaleFactor + buffer->textSpacing);
-
-            // if (textOffset.x+newXOff > buffer->renderTex.texture.width) {
-            //     textOffset.x = 0;
-            //     textOffset.y += (buffer->fontSize + buffer->textLineSpacing);
-            // }
-
-            if ((codepoint != ' ') &&
-                (codepoint != '\t') &&
-                (textOffset.y >= -buffer->fontSize) &&
-                ((textOffset.y+buffer->fontSize) <= buffer->renderTex.texture.height)) {
-                Vector2 pos = {floor(textOffset.x), floor(textOffset.y)};
-
-                DrawTextCodepoint(buffer->font,
-                                codepoint,
-                                pos,
-                                buffer->fontSize,
-                                WHITE);
-                }
-
-            textOffset.x += newXOff;
-        }
+    if (!mesh->built) {
+        Line l = buffer->lines.array[line];
+        LineMeshBuild(mesh, buffer->font, buffer->fontSize, buffer->textSpacing,
+                      buffer->buffer.array+l.start, l.end-l.start);
     }
-    // EndShaderMode();
-    EndBlendMode();
 
-    // Draw the status bar.
-    f32 statusBarHeight = buffer->fontSize + 2*buffer->textLineSpacing;
-    DrawRectangle(0, GetScreenHeight()-statusBarHeight, GetScreenWidth(), statusBarHeight, WHITE);
+    LineMeshDraw(mesh, buffer->font.texture, origin, buffer->viewport.x+buffer->viewport.width, WHITE);
+}
 
-    char *lcText = tfmt(buffer->tempAlloc, "Line: %d Col: %d", buffer->cursorLine+1, buffer->cursorPos+1-buffer->lines.array[buffer->cursorLine].start);
+void BufferDrawStatus(Buffer *buffer) {
+    Rectangle vp = buffer->viewport;
 
-    Vector2 mt = MeasureTextEx(buffer->font, lcText, buffer->fontSize, buffer->textSpacing);
+    if (buffer->dirty & BDirty_Status) BufferUpdateStatus(buffer);
+
+    f32 statusBarHeight = buffer->fontSize + 2*buffer->textLineSpacing;
+    f32 statusBarY = vp.y+vp.height-(buffer->fontSize + buffer->textLineSpacing);
+    DrawRectangle(vp.x, vp.y+vp.height-statusBarHeight, vp.width, statusBarHeight, WHITE);
 
-    // DrawFText(&buffer->tempArena,
-    //           400, 300, 20, PINK, "mt: (%.4f,%.4f)", mt.x, mt.y);
     // BeginShaderMode(buffer->shader);
-    DrawTextEx(buffer->font, lcText,
-               (Vector2){buffer->renderTex.texture.width-(mt.x + 2*buffer->textSpacing),
-                   buffer->renderTex.texture.height-(buffer->fontSize + buffer->textLineSpacing)},
+    DrawTextEx(buffer->font, buffer->status.lineCol.array,
+               (Vector2){vp.x+vp.width-(buffer->status.lineColWidth + 2*buffer->textSpacing), statusBarY},
                buffer->fontSize, buffer->textSpacing, BLACK);
-    // EndShaderMode();
-
-    char *pathText = tfmt(buffer->tempAlloc, "<%.*s>", buffer->path.len, buffer->path.array);
 
-    mt = MeasureTextEx(buffer->font, pathText, buffer->fontSize, buffer->textSpacing);
+    DrawTextEx(buffer->font, buffer->status.path.array,
+               (Vector2){vp.x+2*buffer->textSpacing+(vp.width/2)-(buffer->status.pathWidth/2), statusBarY},
+               buffer->fontSize, buffer->textSpacing, BLACK);
 
-    // BeginShaderMode(buffer->shader);
-    DrawTextEx(buffer->font, pathText,
-               (Vector2){2*buffer->textSpacing+(buffer->renderTex.texture.width/2)-(mt.x/2),
-                   buffer->renderTex.texture.height-(buffer->fontSize + buffer->textLineSpacing)},
+    DrawTextEx(buffer->font, buffer->status.msg.array,
+               (Vector2){vp.x+2*buffer->textSpacing, statusBarY},
                buffer->fontSize, buffer->textSpacing, BLACK);
     // EndShaderMode();
+}
+
+void DrawBuffer(Buffer *buffer) {
+    Rectangle vp = buffer->viewport;
+
+    BeginScissorMode(vp.x, vp.y, vp.width, vp.height);
+    DrawRectangleRec(vp, BLACK);
+
+    f32 lineHeight = buffer->fontSize + buffer->textLineSpacing;
 
-    char *msgText = tfmt(buffer->tempAlloc, "%.*s", buffer->msg.len, buffer->msg.array);
+    // Rows skip folded lines, only the rows on screen are looked up.
+    usize firstRow = buffer->viewLoc/lineHeight;
+    usize lastRow = (buffer->viewLoc+vp.height)/lineHeight + 1;
+    usize rowCount = FoldRowCount(&buffer->folds, buffer->lines.len);
+    if (lastRow > rowCount) lastRow = rowCount;
 
-    mt = MeasureTextEx(buffer->font, pathText, buffer->fontSize, buffer->textSpacing);
+    // Headers of folded blocks get a band behind them.
+    for (usize row = firstRow; row < lastRow; ++row) {
+        usize next = FoldLineOfRow(&buffer->folds, row)+1;
+        Fold *fold = FoldAt(&buffer->folds, next);
+        if (fold && fold->start == next)
+            DrawRectangle(vp.x, vp.y + floor(row*lineHeight - buffer->viewLoc), vp.width, lineHeight, (Color){40, 40, 70, 255});
+    }
+
+    usize cursorRow = FoldRowOfLine(&buffer->folds, buffer->cursorLine);
+    b8 cursorVisible = cursorRow >= firstRow && cursorRow < lastRow;
+    f32 x = 0;
+
+    if (cursorVisible) x = BufferDrawCursor(buffer, vp.y+cursorRow*lineHeight-buffer->viewLoc);
 
     // BeginShaderMode(buffer->shader);
-    DrawTextEx(buffer->font, msgText,
-               (Vector2){2*buffer->textSpacing,
-                   buffer->renderTex.texture.height-(buffer->fontSize + buffer->textLineSpacing)},
-               buffer->fontSize, buffer->textSpacing, BLACK);
+    BeginBlendMode(BLEND_ALPHA);
+    // NOTE(m1cha1s): All visible lines go out as one quad batch against the font atlas.
+    for (usize row = firstRow; row < lastRow; ++row)
+        BufferDrawLine(buffer, FoldLineOfRow(&buffer->folds, row), (Vector2){vp.x, vp.y + floor(row*lineHeight - buffer->viewLoc)});
     // EndShaderMode();
+    EndBlendMode();
+
+    if (buffer->completion.count) {
+        if (buffer->mode == BMode_Open) DrawFileList(buffer);
+        else if (cursorVisible) DrawCompletion(buffer, x);
+    }
 
-    EndTextureMode();
+    BufferDrawStatus(buffer);
 
-    DrawTextureRec(buffer->renderTex.texture,
-                   (Rectangle) {0,0,buffer->renderTex.texture.width,-buffer->renderTex.texture.height},
-                   (Vector2){0,0},
-                   WHITE);
+    EndScissorMode();
+
+    buffer->dirty = 0;
 
     memClear(buffer->tempAlloc);
 }
 
+// Called after cursorLine was stepped by one, the cursor position is still
+// on the old line. The step is redone over visible rows so folds are skipped.
 void BufferFixCursorPos(Buffer *buffer) {
-    usize start = buffer->lines.array[buffer->cursorLine].start;
-    usize end   = buffer->lines.array[buffer->cursorLine].end;
+    Line *lines = buffer->lines.array;
 
-    usize col = 0;
+    usize old = buffer->cursorLine;
+    if (buffer->cursorPos > lines[buffer->cursorLine].end) old = buffer->cursorLine+1;
+    else if (buffer->cursorPos < lines[buffer->cursorLine].start) old = buffer->cursorLine-1;
 
-    if (buffer->cursorPos > end) {
-        col = buffer->cursorPos - buffer->lines.array[buffer->cursorLine+1].start;
-    } else if (buffer->cursorPos < start) {
-        col = buffer->cursorPos - buffer->lines.array[buffer->cursorLine-1].start;
-    } else {
-        col = buffer->cursorPos - buffer->lines.array[buffer->cursorLine].start;
+    usize col = buffer->cursorPos - lines[old].start;
+
+    if (old != buffer->cursorLine) {
+        usize row = FoldRowOfLine(&buffer->folds, old);
+        usize rowCount = FoldRowCount(&buffer->folds, buffer->lines.len);
+        if (old < buffer->cursorLine) row++;
+        else row--;
+        if (row >= rowCount) row = rowCount-1;
+        buffer->cursorLine = FoldLineOfRow(&buffer->folds, row);
     }
 
+    usize start = lines[buffer->cursorLine].start;
+    usize end   = lines[buffer->cursorLine].end;
     buffer->cursorPos = clamp(start+col, start, end);
 }
 
+// Last line starting at or before pos.
+static usize BufferLineOfPos(Buffer *buffer, usize pos) {
+    usize lo = 0, hi = buffer->lines.len;
+    while (hi-lo > 1) {
+        usize mid = lo + (hi-lo)/2;
+        if (buffer->lines.array[mid].start <= pos) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
 void BufferFixCursorLineCol(Buffer *buffer) {
-    b8 foundLine = false;
-    usize i = 0;
-    for (i = 0; i < buffer->lines.len; ++i) {
-        usize start = buffer->lines.array[i].start;
-        usize end   = buffer->lines.array[i].end;
-        if (buffer->cursorPos >= start && buffer->cursorPos <= end) {
-            foundLine = true;
-            break;
+    Line *lines = buffer->lines.array;
+
+    usize lo = BufferLineOfPos(buffer, buffer->cursorPos);
+    if (buffer->cursorPos > lines[lo].end) buffer->cursorPos = lines[lo].end;
+
+    // Stepping into a fold jumps over it.
+    Fold *fold = FoldAt(&buffer->folds, lo);
+    if (fold) {
+        if (lo > buffer->cursorLine && fold->end+1 < buffer->lines.len) {
+            lo = fold->end+1;
+            buffer->cursorPos = lines[lo].start;
+        } else {
+            lo = fold->start-1;
+            buffer->cursorPos = lines[lo].end;
         }
     }
 
-    if (foundLine) {
-        buffer->cursorLine=i;
-    } else {
-        buffer->cursorPos = buffer->lines.array[i].end;
-    }
+    buffer->cursorLine = lo;
 }
 
 s32 BufferOpenFile(Buffer *buffer) {
@@ -255,32 +413,21 @@ s32 BufferOpenFile(Buffer *buffer) {
 
     if (!buffer->file) {
         buffer->path.len = 0;
-        char * msg = tfmt(buffer->tempAlloc, "%s not found", path);
-        buffer->msg.len=0;
-        for (usize i=0;i<strlen(msg);++i) Arraylist_char_Push(&buffer->msg, msg[i]);
+        BufferSetMsg(buffer, tfmt(buffer->tempAlloc, "%s not found", path));
         return -1;
     }
 
-    fseek(buffer->file, 0L, SEEK_END);
-    usize fileSize = ftell(buffer->file);
-    rewind(buffer->file);
-
-    char *fileContents = malloc(fileSize+1);
-
-    fread(fileContents, fileSize, 1, buffer->file);
     fclose(buffer->file);
 
-    buffer->cursorPos = 0;
-
-    InsertBufferBlock(buffer, fileContents, fileSize);
-
-    BufferFixCursorLineCol(buffer);
+    MappedFile file = MapFile(path);
+    IngestBuffer(buffer, file.data, file.size);
+    UnmapFile(file);
 
     f64 elapsedTime = GetTime()-startTime;
 
-    char * msg = tfmt(buffer->tempAlloc, "Opened (%.2fs)", elapsedTime);
-    buffer->msg.len=0;
-    for (usize i=0;i<strlen(msg);++i) Arraylist_char_Push(&buffer->msg, msg[i]);
+    BufferSetMsg(buffer, tfmt(buffer->tempAlloc, "Opened (%.2fs)", elapsedTime));
+
+    return 0;
 }
 
 s32 BufferSave(Buffer *buffer) {
@@ -290,9 +437,7 @@ s32 BufferSave(Buffer *buffer) {
     buffer->file = fopen(path, "w");
 
     if (!buffer->file) {
-        char * msg = tfmt(buffer->tempAlloc, "%s not found", path);
-        buffer->msg.len=0;
-        for (usize i=0;i<strlen(msg);++i) Arraylist_char_Push(&buffer->msg, msg[i]);
+        BufferSetMsg(buffer, tfmt(buffer->tempAlloc, "%s not found", path));
         return -1;
     }
 
@@ -306,25 +451,279 @@ s32 BufferSave(Buffer *buffer) {
 
     f64 elapsedTime = GetTime()-startTime;
 
-    char * msg = tfmt(buffer->tempAlloc, "Saved (%.2fs)", elapsedTime);
-    buffer->msg.len=0;
-    for (usize i=0;i<strlen(msg);++i) Arraylist_char_Push(&buffer->msg, msg[i]);
+    BufferSetMsg(buffer, tfmt(buffer->tempAlloc, "Saved (%.2fs)", elapsedTime));
+
+    return 0;
 }
 
-void BufferLoadFont(Buffer *buffer, s32 size) {
-    s32 fdSize = 0;
-    // char *fd = LoadFileData("assets/IosevkaFixed-Medium.ttf", &fdSize);
-    char *fd = LoadFileData(buffer->fontPath, &fdSize);
+// raylib allocates the font itself, so its memory is only accounted for here.
+static usize FontBytes(Font font) {
+    return font.glyphCount*(sizeof(GlyphInfo)+sizeof(Rectangle)) +
+        GetPixelDataSize(font.texture.width, font.texture.height, font.texture.format);
+}
 
-    buffer->font.baseSize = size;
-    buffer->font.glyphCount = 95;
-    // buffer->font.glyphs = LoadFontData(fd, fdSize, size, 0, 0, FONT_SDF);
-    buffer->font.glyphs = LoadFontData(fd, fdSize, size, 0, 0, FONT_DEFAULT);
+void BufferUnloadFont(Buffer *buffer) {
+    if (!buffer->font.texture.id) return;
 
-    Image atlas = GenImageFontAtlas(buffer->font.glyphs, &buffer->font.recs, 95, size, 1, 1);
-    buffer->font.texture = LoadTextureFromImage(atlas);
-    UnloadImage(atlas);
-    UnloadFileData(fd);
+    MemStatsRecord(&MemTagStats[MemTag_Font], FontBytes(buffer->font), true);
+    UnloadFont(buffer->font);
+    buffer->font = (Font){0};
+}
+
+void BufferLoadFont(Buffer *buffer, s32 size) {
+    BufferUnloadFont(buffer);
+
+    // buffer->font = LoadFontCached(buffer->fontPath, size, FONT_SDF);
+    buffer->font = LoadFontCached(buffer->fontPath, size, FONT_DEFAULT);
+    if (buffer->font.texture.id) MemStatsRecord(&MemTagStats[MemTag_Font], FontBytes(buffer->font), false);
 
     SetTextureFilter(buffer->font.texture, TEXTURE_FILTER_BILINEAR);
+
+    LineCacheInvalidateAll(&buffer->meshes);
+    buffer->dirty |= BDirty_All;
+}
+
+void BufferSetMsg(Buffer *buffer, char *msg) {
+    buffer->msg.len=0;
+    for (usize i=0;msg[i];++i) Arraylist_char_Push(&buffer->msg, msg[i]);
+    buffer->dirty |= BDirty_Status;
+}
+
+// Appends at the end of the buffer without moving the cursor.
+void BufferAppend(Buffer *buffer, s32 *text, usize len) {
+    BufferTouchLines(buffer, buffer->lines.len-1, buffer->lines.len-1);
+    LineCacheInvalidate(&buffer->meshes, buffer->lines.len-1);
+
+    for (usize i = 0; i < len; ++i) {
+        Arraylist_s32_Push(&buffer->buffer, text[i]);
+
+        if (text[i] == '\n') {
+            buffer->lines.array[buffer->lines.len-1].end = buffer->buffer.len-1;
+            Arraylist_Line_Push(&buffer->lines, (Line){buffer->buffer.len, buffer->buffer.len});
+            LineCacheInsert(&buffer->meshes, buffer->lines.len-1);
+        }
+    }
+
+    buffer->lines.array[buffer->lines.len-1].end = buffer->buffer.len;
+    buffer->edit.last = buffer->lines.len-1;
+    buffer->dirty |= BDirty_All;
+}
+
+void BufferClear(Buffer *buffer) {
+    BufferResetEdit(buffer);
+
+    buffer->buffer.len = 0;
+    buffer->cursorPos = 0;
+    buffer->cursorLine = 0;
+    buffer->viewLoc = 0;
+    RescanBuffer(buffer);
+    buffer->edit.last = buffer->lines.len-1;
+}
+
+// Moves the cursor to a zero based line and column and scrolls it into view.
+void BufferGoto(Buffer *buffer, usize line, usize col) {
+    if (line >= buffer->lines.len) line = buffer->lines.len-1;
+
+    Line l = buffer->lines.array[line];
+    buffer->cursorLine = line;
+    buffer->cursorPos = min(l.start+col, l.end);
+    BufferRevealLine(buffer, line);
+
+    f32 lineHeight = buffer->fontSize + buffer->textLineSpacing;
+    f32 y = FoldRowOfLine(&buffer->folds, line)*lineHeight;
+    if (y < buffer->viewLoc || y+2*lineHeight > buffer->viewLoc+buffer->viewport.height)
+        buffer->viewLoc = max(0, y - buffer->viewport.height/2);
+
+    buffer->dirty |= BDirty_All;
+}
+
+static void EditInsertText(Arraylist_s32 *al, usize at, s32 *text, usize len) {
+    while (al->len+len > al->cap) Arraylist_s32_Grow(al);
+
+    memmove(al->array+at+len, al->array+at, (al->len-at)*sizeof(s32));
+    memcpy(al->array+at, text, len*sizeof(s32));
+    al->len += len;
+}
+
+// Grows the tracked edit to cover [first, last]. Must be called before the
+// lines are modified, so the text saved for newly covered lines is the old one.
+void BufferTouchLines(Buffer *buffer, usize first, usize last) {
+    LineEdit *e = &buffer->edit;
+    Line *lines = buffer->lines.array;
+
+    if (e->active && e->reset) {
+        e->resetEdited = true; // Already covers everything.
+        return;
+    }
+
+    if (!e->active) {
+        e->active = true;
+        e->reset = false;
+        e->first = first;
+        e->last = last;
+        e->old.len = 0;
+        EditInsertText(&e->old, 0, buffer->buffer.array+lines[first].start, lines[last].end-lines[first].start);
+        return;
+    }
+
+    // Lines between the old range and the new ones are untouched, so the
+    // current text is their old text. Both slices include the joining '\n'.
+    if (first < e->first) {
+        EditInsertText(&e->old, 0, buffer->buffer.array+lines[first].start, lines[e->first].start-lines[first].start);
+        e->first = first;
+    }
+    if (last > e->last) {
+        EditInsertText(&e->old, e->old.len, buffer->buffer.array+lines[e->last].end, lines[last].end-lines[e->last].end);
+        e->last = last;
+    }
+}
+
+// Block opened by a brace left open on the line, or else the innermost one
+// around it. The closing brace line stays visible.
+static b8 BraceBlock(Buffer *buffer, usize line, usize *start, usize *end) {
+    s32 *text = buffer->buffer.array;
+    Line *lines = buffer->lines.array;
+
+    usize header = line;
+    usize from = lines[line].end;
+    s64 depth = 0;
+    for (usize i = lines[line].start; i < lines[line].end; ++i) {
+        if (text[i] == '{') depth++;
+        else if (text[i] == '}' && depth) depth--;
+    }
+
+    if (!depth) {
+        usize i = lines[line].start;
+        s64 closed = 0;
+        while (i && !depth) {
+            i--;
+            if (text[i] == '}') closed++;
+            else if (text[i] == '{') {
+                if (closed) closed--;
+                else depth = 1;
+            }
+        }
+        if (!depth) return false;
+
+        header = BufferLineOfPos(buffer, i);
+        from = i+1;
+    }
+
+    for (usize i = from; i < buffer->buffer.len; ++i) {
+        if (text[i] == '{') depth++;
+        else if (text[i] == '}' && !--depth) {
+            usize close = BufferLineOfPos(buffer, i);
+            if (close < header+2) return false;
+
+            *start = header+1;
+            *end = close-1;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Tabs count as 4 columns, blank lines have no indentation of their own.
+static usize LineIndent(Buffer *buffer, usize line, b8 *blank) {
+    Line l = buffer->lines.array[line];
+    usize indent = 0;
+    usize i = l.start;
+    for (; i < l.end && (buffer->buffer.array[i] == ' ' || buffer->buffer.array[i] == '\t'); ++i)
+        indent += buffer->buffer.array[i] == '\t' ? 4 : 1;
+
+    *blank = i == l.end;
+    return indent;
+}
+
+// Lines indented deeper than the line, or than the closest shallower line above it.
+static b8 IndentBlock(Buffer *buffer, usize line, usize *start, usize *end) {
+    usize lineCount = buffer->lines.len;
+    b8 blank;
+
+    usize next = line+1;
+    for (; next < lineCount; ++next) {
+        LineIndent(buffer, next, &blank);
+        if (!blank) break;
+    }
+    usize nextIndent = next < lineCount ? LineIndent(buffer, next, &blank) : 0;
+
+    usize header = line;
+    usize indent = LineIndent(buffer, line, &blank);
+    if (blank) indent = nextIndent;
+
+    if (blank || nextIndent <= indent) {
+        for (header = line; header--;) {
+            usize i = LineIndent(buffer, header, &blank);
+            if (!blank && i < indent) break;
+        }
+        if (header >= lineCount) return false;
+        indent = LineIndent(buffer, header, &blank);
+    }
+
+    usize last = header;
+    for (usize i = header+1; i < lineCount; ++i) {
+        usize lineIndent = LineIndent(buffer, i, &blank);
+        if (blank) continue;
+        if (lineIndent <= indent) break;
+        last = i;
+    }
+    if (last == header) return false;
+
+    *start = header+1;
+    *end = last;
+    return true;
+}
+
+// Unfolds the fold under the cursor line, or folds the block at the cursor.
+// Braces decide the block when there is one, indentation otherwise.
+void BufferToggleFold(Buffer *buffer) {
+    Fold *fold = FoldAt(&buffer->folds, buffer->cursorLine+1);
+    if (fold && fold->start == buffer->cursorLine+1) {
+        FoldRemove(&buffer->folds, fold);
+        buffer->dirty |= BDirty_All;
+        return;
+    }
+
+    usize start, end;
+    if (!BraceBlock(buffer, buffer->cursorLine, &start, &end) &&
+        !IndentBlock(buffer, buffer->cursorLine, &start, &end)) {
+        BufferSetMsg(buffer, "Nothing to fold");
+        return;
+    }
+
+    FoldAdd(&buffer->folds, start, end);
+
+    if (buffer->cursorLine >= start) {
+        buffer->cursorLine = start-1;
+        buffer->cursorPos = buffer->lines.array[start-1].end;
+    }
+
+    BufferSetMsg(buffer, tfmt(buffer->tempAlloc, "Folded %zu lines", end-start+1));
+    buffer->dirty |= BDirty_All;
+}
+
+void BufferRevealLine(Buffer *buffer, usize line) {
+    Fold *fold;
+    while ((fold = FoldAt(&buffer->folds, line))) {
+        FoldRemove(&buffer->folds, fold);
+        buffer->dirty |= BDirty_All;
+    }
+}
+
+// The whole buffer is about to be replaced. Consumers rescan it instead of
+// diffing lines, so the old text isn't copied.
+void BufferResetEdit(Buffer *buffer) {
+    LineEdit *e = &buffer->edit;
+    e->active = true;
+    e->reset = true;
+    e->resetEdited = false;
+    e->first = 0;
+    e->last = 0;
+    e->old.len = 0;
+}
+
+char *BufferCompletionItem(Buffer *buffer, usize i) {
+    char *item = buffer->completion.items.array;
+    while (i--) item += strlen(item)+1;
+    return item;
 }
@@ -3,6 +3,8 @@
 
 #include "utils.h"
 #include "memory.h"
+#include "textrender.h"
+#include "fold.h"
 
 #include <stdio.h>
 
@@ -18,6 +20,8 @@ typedef struct _Line {
 #include "arraylist.h"
 #define T char
 #include "arraylist.h"
+#define T u32
+#include "arraylist.h"
 #define T Line
 #include "arraylist.h"
 
@@ -26,8 +30,47 @@ typedef struct _Line {
 typedef enum _BufferMode {
     BMode_Norm,
     BMode_Open,
+    BMode_Compile,
+    BMode_Search, // Typing a grep pattern.
+    BMode_Grep,
 } BufferMode;
 
+typedef enum _BufferDirty {
+    BDirty_Text   = 1<<0,
+    BDirty_Cursor = 1<<1,
+    BDirty_Status = 1<<2,
+    BDirty_All    = BDirty_Text|BDirty_Cursor|BDirty_Status,
+} BufferDirty;
+
+// NUL terminated copies of the status bar strings, rebuilt only on BDirty_Status.
+typedef struct _StatusBar {
+    Arraylist_char msg;
+    Arraylist_char path;
+    Arraylist_char lineCol;
+    f32 pathWidth;
+    f32 lineColWidth;
+} StatusBar;
+
+// Lines touched since the edit was last taken, with their text from before
+// the first touch. Lets indexers redo only what changed.
+typedef struct _LineEdit {
+    b8 active;
+    b8 reset; // The whole buffer was replaced, nothing is kept in old.
+    b8 resetEdited; // Touched again since, the text no longer matches the file it came from.
+    usize first;
+    usize last;
+    Arraylist_s32 old; // Text of the old range, lines joined with '\n'.
+} LineEdit;
+
+#define COMPLETION_MAX 8
+
+typedef struct _CompletionPopup {
+    Arraylist_char items; // NUL separated candidates.
+    usize count;
+    usize selected;
+    usize prefixLen;
+} CompletionPopup;
+
 typedef struct _Buffer {
     char *fontPath;
     Font font;
@@ -48,7 +91,7 @@ typedef struct _Buffer {
     FILE *file;
     Arraylist_char path;
 
-    RenderTexture2D renderTex;
+    Rectangle viewport;
     f32 viewLoc;
 
     BufferMode mode;
@@ -56,18 +99,41 @@ typedef struct _Buffer {
     Arraylist_char msg;
 
     Arraylist_Line lines;
+    Arraylist_LineMesh meshes; // Parallel to lines, rebuilt lazily on draw.
+    Arraylist_Fold folds;
+
+    LineEdit edit;
+    CompletionPopup completion;
+
+    u32 dirty;
+    b8 busy; // Set while a background job feeds this buffer, the main loop polls instead of waiting.
+    StatusBar status;
 } Buffer;
 
 Buffer InitBuffer(usize cap);
 void DeinitBuffer(Buffer *buffer);
 void InsertBuffer(Buffer *buffer, s32 codepoint);
 void BackspaceBuffer(Buffer *buffer);
+void DeleteBuffer(Buffer *buffer);
 void DrawBuffer(Buffer *buffer);
+f32 BufferDrawCursor(Buffer *buffer, f32 y);
+void BufferDrawLine(Buffer *buffer, usize line, Vector2 origin);
+void BufferDrawStatus(Buffer *buffer);
 s32 BufferOpenFile(Buffer *buffer);// s32 *buffer;
     // usize bufferLen;
     // usize bufferCap;
 s32 BufferSave(Buffer *buffer);
 void BufferLoadFont(Buffer *buffer, s32 size);
+void BufferUnloadFont(Buffer *buffer);
+void BufferSetMsg(Buffer *buffer, char *msg);
+void BufferAppend(Buffer *buffer, s32 *text, usize len);
+void BufferClear(Buffer *buffer);
+void BufferGoto(Buffer *buffer, usize line, usize col);
+void BufferTouchLines(Buffer *buffer, usize first, usize last);
+void BufferResetEdit(Buffer *buffer);
+void BufferToggleFold(Buffer *buffer);
+void BufferRevealLine(Buffer *buffer, usize line);
+char *BufferCompletionItem(Buffer *buffer, usize i);
 
 void BufferFixCursorPos(Buffer *buffer);
 void BufferFixCursorLineCol(Buffer *buffer);
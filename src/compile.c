@@ -0,0 +1,272 @@
+#include "compile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+Compile InitCompile(void) {
+    Compile c = {
+        .pid = -1,
+        .fd = -1,
+        .ring = InitRing(TagAlloc(MemTag_UI), COMPILE_RING_SIZE),
+        .diags = Arraylist_Diagnostic_Init(TagAlloc(MemTag_Lines), 16),
+        .paths = Arraylist_char_Init(TagAlloc(MemTag_Lines), 256),
+    };
+    return c;
+}
+
+void DeinitCompile(Compile *c) {
+    CompileStop(c);
+    DeinitRing(TagAlloc(MemTag_UI), &c->ring);
+    Arraylist_Diagnostic_Deinit(&c->diags);
+    Arraylist_char_Deinit(&c->paths);
+}
+
+// Drains the pipe into the ring so the child never blocks on a full pipe
+// while the UI thread is busy.
+static void *CompileReader(void *data) {
+    Compile *c = data;
+    u8 chunk[KB(4)];
+
+    struct pollfd pfd = {.fd = c->fd, .events = POLLIN};
+
+    while (!c->stop) {
+        if (poll(&pfd, 1, 100) <= 0) continue;
+
+        ssize_t n = read(c->fd, chunk, sizeof(chunk));
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) continue;
+            break;
+        }
+
+        for (usize written = 0; written < (usize)n && !c->stop;) {
+            usize w = RingWrite(&c->ring, chunk+written, n-written);
+            if (!w) usleep(1000); // Ring is full, wait for the UI to catch up.
+            written += w;
+        }
+    }
+
+    c->readerDone = true;
+    return NULL;
+}
+
+s32 CompileStart(Compile *c, Buffer *out, char *command) {
+    CompileStop(c);
+
+    s32 fds[2];
+    if (pipe(fds) < 0) {
+        BufferSetMsg(out, "Failed to create pipe");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        BufferSetMsg(out, "Failed to spawn compiler");
+        return -1;
+    }
+
+    if (pid == 0) {
+        setpgid(0, 0); // So CompileStop can signal the whole job.
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+        _exit(127);
+    }
+
+    // Also from the parent, so the group exists even if we stop before the
+    // child got to run.
+    setpgid(pid, pid);
+
+    close(fds[1]);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    c->pid = pid;
+    c->fd = fds[0];
+    c->stop = false;
+    c->readerDone = false;
+    c->running = true;
+    c->carryLen = 0;
+    c->parsedLines = 0;
+    c->diags.len = 0;
+    c->paths.len = 0;
+    c->nextDiag = 0;
+    c->startTime = GetTime();
+    ResetRing(&c->ring);
+
+    BufferClear(out);
+    out->mode = BMode_Compile;
+    out->path.len = 0;
+    for (usize i=0;command[i];++i) Arraylist_char_Push(&out->path, command[i]);
+    BufferSetMsg(out, "Compiling...");
+
+    pthread_create(&c->reader, NULL, CompileReader, c);
+    out->busy = true;
+
+    return 0;
+}
+
+void CompileStop(Compile *c) {
+    if (!c->running) return;
+
+    c->stop = true;
+    kill(-c->pid, SIGTERM);
+
+    // Don't hang the UI on a job that ignores TERM.
+    f64 deadline = GetTime() + COMPILE_STOP_TIMEOUT;
+    while (waitpid(c->pid, NULL, WNOHANG) == 0) {
+        if (GetTime() > deadline) {
+            kill(-c->pid, SIGKILL);
+            waitpid(c->pid, NULL, 0);
+            break;
+        }
+        usleep(1000);
+    }
+
+    pthread_join(c->reader, NULL);
+    close(c->fd);
+
+    c->fd = -1;
+    c->pid = -1;
+    c->running = false;
+}
+
+static b8 IsDigit(s32 c) {
+    return c >= '0' && c <= '9';
+}
+
+// Matches `path:line:` and `path:line:col:` at the start of a line.
+static b8 ParseDiagnostic(Compile *c, s32 *text, usize len, usize logLine) {
+    usize i = 0;
+    while (i < len && text[i] != ':' && text[i] != ' ' && text[i] != '\t') i++;
+    if (!i || i >= len || text[i] != ':') return false;
+    usize pathLen = i++;
+
+    s32 line = 0;
+    usize digits = i;
+    while (i < len && IsDigit(text[i])) line = line*10 + (text[i++]-'0');
+    if (i == digits || i >= len || text[i] != ':') return false;
+    i++;
+
+    s32 col = 0;
+    digits = i;
+    while (i < len && IsDigit(text[i])) col = col*10 + (text[i++]-'0');
+    if (i != digits && (i >= len || text[i] != ':')) col = 0;
+
+    Diagnostic d = {
+        .logLine = logLine,
+        .pathStart = c->paths.len,
+        .pathLen = pathLen,
+        .line = line,
+        .col = col,
+    };
+
+    for (usize j=0;j<pathLen;++j) Arraylist_char_Push(&c->paths, (char)text[j]);
+    Arraylist_char_Push(&c->paths, 0);
+    Arraylist_Diagnostic_Push(&c->diags, d);
+
+    return true;
+}
+
+static void CompileParseLines(Compile *c, Buffer *out, usize upTo) {
+    for (; c->parsedLines < upTo; ++c->parsedLines) {
+        Line l = out->lines.array[c->parsedLines];
+        ParseDiagnostic(c, out->buffer.array+l.start, l.end-l.start, c->parsedLines);
+    }
+}
+
+// Length of data that ends on a complete UTF-8 sequence.
+static usize Utf8CompleteLen(u8 *data, usize len) {
+    usize i = len;
+    usize back = 0;
+    while (i && back < 4) {
+        u8 b = data[--i];
+        back++;
+        if ((b & 0xC0) != 0x80) {
+            usize need = (b < 0x80) ? 1 : (b >= 0xF0) ? 4 : (b >= 0xE0) ? 3 : 2;
+            return (back >= need) ? len : i;
+        }
+    }
+    return len;
+}
+
+void CompileUpdate(Compile *c, Buffer *out) {
+    if (!c->running) return;
+
+    static u8 chunk[COMPILE_DRAIN_BUDGET+4];
+    static s32 text[COMPILE_DRAIN_BUDGET+4];
+
+    memcpy(chunk, c->carry, c->carryLen);
+    usize len = c->carryLen + RingRead(&c->ring, chunk+c->carryLen, COMPILE_DRAIN_BUDGET);
+
+    usize complete = Utf8CompleteLen(chunk, len);
+    c->carryLen = len-complete;
+    memcpy(c->carry, chunk+complete, c->carryLen);
+
+    usize textLen = 0;
+    for (usize i=0;i<complete;) {
+        s32 cps = 0;
+        s32 codepoint = GetCodepointNext((char*)chunk+i, &cps);
+        if (codepoint != '\r') text[textLen++] = codepoint;
+        i += cps;
+    }
+
+    if (textLen) {
+        BufferAppend(out, text, textLen);
+        // The last line may still be incomplete, it is parsed once it ends.
+        CompileParseLines(c, out, out->lines.len-1);
+    }
+
+    if (c->readerDone && !RingCount(&c->ring)) {
+        s32 status = 0;
+        if (waitpid(c->pid, &status, WNOHANG) == 0) return;
+
+        CompileParseLines(c, out, out->lines.len);
+        pthread_join(c->reader, NULL); // Already done, returns right away.
+        close(c->fd);
+
+        c->fd = -1;
+        c->pid = -1;
+        c->running = false;
+        out->busy = false;
+
+        s32 code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        BufferSetMsg(out, tfmt(out->tempAlloc, "%s (exit %d, %d locations, %.2fs)",
+                               code ? "Compilation failed" : "Compilation finished",
+                               code, (s32)c->diags.len, GetTime()-c->startTime));
+    }
+}
+
+Diagnostic *CompileDiagnosticAt(Compile *c, usize logLine) {
+    usize lo = 0, hi = c->diags.len;
+    while (lo < hi) {
+        usize mid = lo + (hi-lo)/2;
+        if (c->diags.array[mid].logLine < logLine) lo = mid+1;
+        else hi = mid;
+    }
+
+    if (lo < c->diags.len && c->diags.array[lo].logLine == logLine) {
+        c->nextDiag = lo+1;
+        return c->diags.array+lo;
+    }
+    return NULL;
+}
+
+Diagnostic *CompileNextError(Compile *c) {
+    if (c->nextDiag >= c->diags.len) return NULL;
+    return c->diags.array+c->nextDiag++;
+}
+
+char *CompileDiagnosticPath(Compile *c, Diagnostic *d) {
+    return c->paths.array+d->pathStart;
+}
@@ -0,0 +1,58 @@
+#ifndef _COMPILE_H
+#define _COMPILE_H
+
+#include "utils.h"
+#include "ring.h"
+#include "buffer.h"
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#define COMPILE_RING_SIZE    MB(1)
+#define COMPILE_DRAIN_BUDGET KB(64) // Bytes moved into the buffer per frame.
+#define COMPILE_STOP_TIMEOUT 0.5     // Seconds after SIGTERM before SIGKILL.
+
+// A `file:line[:col]:` location found in the compile output.
+typedef struct _Diagnostic {
+    usize logLine; // Line in the compile buffer.
+    usize pathStart;
+    usize pathLen;
+    s32 line;
+    s32 col;
+} Diagnostic;
+
+#define T Diagnostic
+#include "arraylist.h"
+
+typedef struct _Compile {
+    pid_t pid;
+    s32 fd;
+    pthread_t reader;
+    _Atomic b8 readerDone;
+    _Atomic b8 stop;
+    b8 running;
+
+    Ring ring;
+    u8 carry[4]; // Incomplete UTF-8 sequence from the previous drain.
+    usize carryLen;
+
+    usize parsedLines;
+    Arraylist_Diagnostic diags;
+    Arraylist_char paths;
+    usize nextDiag;
+
+    f64 startTime;
+} Compile;
+
+Compile InitCompile(void);
+void DeinitCompile(Compile *c);
+
+s32 CompileStart(Compile *c, Buffer *out, char *command);
+void CompileUpdate(Compile *c, Buffer *out);
+void CompileStop(Compile *c);
+
+Diagnostic *CompileDiagnosticAt(Compile *c, usize logLine);
+Diagnostic *CompileNextError(Compile *c);
+char *CompileDiagnosticPath(Compile *c, Diagnostic *d);
+
+#endif // _COMPILE_H
@@ -0,0 +1,443 @@
+#include "diff.h"
+#include "jobs.h"
+
+#include <string.h>
+#include <math.h>
+
+// Fixed by DIFF_MAX_COST, see DiffBisect.
+#define DIFF_V_LEN (2*DIFF_MAX_COST+4)
+
+Diff InitDiff(void) {
+    Diff d = {
+        .ids = {
+            Arraylist_u32_Init(TagAlloc(MemTag_Index), 64),
+            Arraylist_u32_Init(TagAlloc(MemTag_Index), 64),
+        },
+        .rows = Arraylist_DiffRow_Init(TagAlloc(MemTag_UI), 64),
+        .hashes = Arraylist_u64_Init(TagAlloc(MemTag_Index), 64),
+        .changed = {
+            Arraylist_char_Init(TagAlloc(MemTag_UI), 64),
+            Arraylist_char_Init(TagAlloc(MemTag_UI), 64),
+        },
+        .window = Arraylist_DiffRow_Init(TagAlloc(MemTag_UI), 64),
+        .v = memAlloc(TagAlloc(MemTag_UI), 2*DIFF_V_LEN*sizeof(s64)),
+    };
+    return d;
+}
+
+void DeinitDiff(Diff *d) {
+    for (usize i = 0; i < 2; ++i) {
+        Arraylist_u32_Deinit(d->ids+i);
+        Arraylist_char_Deinit(d->changed+i);
+    }
+    Arraylist_DiffRow_Deinit(&d->rows);
+    Arraylist_u64_Deinit(&d->hashes);
+    Arraylist_DiffRow_Deinit(&d->window);
+    memFree(TagAlloc(MemTag_Index), d->keys);
+    memFree(TagAlloc(MemTag_Index), d->values);
+    memFree(TagAlloc(MemTag_UI), d->v);
+}
+
+static u32 RowCoord(DiffRow row, usize side) {
+    return side ? row.b : row.a;
+}
+
+static void Resize(Arraylist_char *al, usize len) {
+    while (al->cap < len) Arraylist_char_Grow(al);
+    al->len = len;
+}
+
+static void SpliceIds(Arraylist_u32 *al, usize at, usize oldCount, usize newCount) {
+    usize len = al->len - oldCount + newCount;
+    while (al->cap < len) Arraylist_u32_Grow(al);
+    if (oldCount != newCount)
+        memmove(al->array+at+newCount, al->array+at+oldCount, (al->len-at-oldCount)*sizeof(u32));
+    al->len = len;
+}
+
+static void SpliceRows(Arraylist_DiffRow *al, usize at, usize oldCount, DiffRow *rows, usize newCount) {
+    usize len = al->len - oldCount + newCount;
+    while (al->cap < len) Arraylist_DiffRow_Grow(al);
+    if (oldCount != newCount)
+        memmove(al->array+at+newCount, al->array+at+oldCount, (al->len-at-oldCount)*sizeof(DiffRow));
+    memcpy(al->array+at, rows, newCount*sizeof(DiffRow));
+    al->len = len;
+}
+
+// ---- Interning -------------------------------------------------------------
+
+typedef struct _DiffHashJob {
+    Buffer *buffer;
+    usize first;
+    usize count;
+    u64 *out;
+} DiffHashJob;
+
+static void DiffHashChunk(void *data, usize i) {
+    DiffHashJob *job = data;
+    Line *lines = job->buffer->lines.array+job->first;
+    s32 *text = job->buffer->buffer.array;
+
+    usize end = (i+1)*DIFF_HASH_CHUNK;
+    if (end > job->count) end = job->count;
+
+    for (usize k = i*DIFF_HASH_CHUNK; k < end; ++k) {
+        u64 h = 14695981039346656037ULL; // FNV-1a
+        for (usize c = lines[k].start; c < lines[k].end; ++c) {
+            h ^= (u32)text[c];
+            h *= 1099511628211ULL;
+        }
+        job->out[k] = h;
+    }
+}
+
+static void DiffGrow(Diff *d) {
+    usize cap = d->cap ? d->cap*2 : KB(4);
+    u64 *keys = memAlloc(TagAlloc(MemTag_Index), cap*sizeof(u64));
+    u32 *values = memAlloc(TagAlloc(MemTag_Index), cap*sizeof(u32));
+    memset(values, 0, cap*sizeof(u32));
+
+    for (usize i = 0; i < d->cap; ++i) {
+        if (!d->values[i]) continue;
+
+        usize at = (d->keys[i] ^ (d->keys[i] >> 32)) & (cap-1);
+        while (values[at]) at = (at+1) & (cap-1);
+        keys[at] = d->keys[i];
+        values[at] = d->values[i];
+    }
+
+    memFree(TagAlloc(MemTag_Index), d->keys);
+    memFree(TagAlloc(MemTag_Index), d->values);
+    d->keys = keys;
+    d->values = values;
+    d->cap = cap;
+}
+
+// NOTE(m1cha1s): Lines are equal when their 64 bit hashes are, we never
+// compare the text itself. Keeping a copy of every distinct line to check
+// against would double the memory of both files, and with n distinct
+// lines the odds of any collision are about n^2/2^65, under 1e-7 for a
+// million lines. A collision shows two different lines as unchanged.
+static u32 DiffIntern(Diff *d, u64 hash) {
+    if ((d->used+1)*10 > d->cap*7) DiffGrow(d);
+
+    usize at = (hash ^ (hash >> 32)) & (d->cap-1);
+    for (; d->values[at]; at = (at+1) & (d->cap-1))
+        if (d->keys[at] == hash) return d->values[at]-1;
+
+    d->keys[at] = hash;
+    d->values[at] = ++d->used; // 0 marks an empty slot.
+    return d->used-1;
+}
+
+// Interns lines [first, first+count) of buffer into out.
+static void DiffInternLines(Diff *d, Buffer *buffer, usize first, usize count, u32 *out) {
+    d->hashes.len = 0;
+    while (d->hashes.cap < count) Arraylist_u64_Grow(&d->hashes);
+
+    DiffHashJob job = {
+        .buffer = buffer,
+        .first = first,
+        .count = count,
+        .out = d->hashes.array,
+    };
+    ParallelFor((count + DIFF_HASH_CHUNK-1) / DIFF_HASH_CHUNK, DiffHashChunk, &job);
+
+    for (usize i = 0; i < count; ++i) out[i] = DiffIntern(d, d->hashes.array[i]);
+}
+
+// ---- Myers -----------------------------------------------------------------
+
+typedef struct _DiffCtx {
+    u32 *a;
+    u32 *b;
+    char *ca; // Set for lines that are not part of the common subsequence.
+    char *cb;
+    s64 *v1;
+    s64 *v2;
+} DiffCtx;
+
+// Finds the middle snake of the O(ND) algorithm, searching from both ends
+// at once. After DIFF_MAX_COST steps, that is what bounds v, it settles for
+// the furthest point the forward search reached, so the window is still
+// split there instead of being marked as replaced.
+static b8 DiffBisect(DiffCtx *c, s64 a0, s64 a1, s64 b0, s64 b1, s64 *sx, s64 *sy) {
+    s64 n = a1-a0, m = b1-b0;
+    s64 maxD = (n+m+1)/2;
+    if (maxD > DIFF_MAX_COST) maxD = DIFF_MAX_COST;
+
+    s64 off = maxD+1;
+    s64 len = 2*maxD+3;
+    for (s64 i = 0; i < len; ++i) c->v1[i] = c->v2[i] = -1;
+    c->v1[off+1] = 0;
+    c->v2[off+1] = 0;
+
+    s64 delta = n-m;
+    b8 front = delta & 1;
+    s64 k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+    s64 bestX = 0, bestY = 0;
+
+    for (s64 d = 0; d < maxD; ++d) {
+        for (s64 k1 = -d+k1start; k1 <= d-k1end; k1 += 2) {
+            s64 k1o = off+k1;
+            s64 x1 = (k1 == -d || (k1 != d && c->v1[k1o-1] < c->v1[k1o+1])) ? c->v1[k1o+1] : c->v1[k1o-1]+1;
+            s64 y1 = x1-k1;
+            while (x1 < n && y1 < m && c->a[a0+x1] == c->b[b0+y1]) x1++, y1++;
+            c->v1[k1o] = x1;
+
+            if (x1 <= n && y1 >= 0 && y1 <= m && x1+y1 > bestX+bestY) bestX = x1, bestY = y1;
+
+            if (x1 > n) k1end += 2;
+            else if (y1 > m) k1start += 2;
+            else if (front) {
+                s64 k2o = off+delta-k1;
+                if (k2o >= 0 && k2o < len && c->v2[k2o] != -1 && x1 >= n-c->v2[k2o]) {
+                    *sx = x1;
+                    *sy = y1;
+                    return true;
+                }
+            }
+        }
+
+        for (s64 k2 = -d+k2start; k2 <= d-k2end; k2 += 2) {
+            s64 k2o = off+k2;
+            s64 x2 = (k2 == -d || (k2 != d && c->v2[k2o-1] < c->v2[k2o+1])) ? c->v2[k2o+1] : c->v2[k2o-1]+1;
+            s64 y2 = x2-k2;
+            while (x2 < n && y2 < m && c->a[a1-x2-1] == c->b[b1-y2-1]) x2++, y2++;
+            c->v2[k2o] = x2;
+
+            if (x2 > n) k2end += 2;
+            else if (y2 > m) k2start += 2;
+            else if (!front) {
+                s64 k1o = off+delta-k2;
+                if (k1o >= 0 && k1o < len && c->v1[k1o] != -1) {
+                    s64 x1 = c->v1[k1o];
+                    if (x1 >= n-x2) {
+                        *sx = x1;
+                        *sy = off+x1-k1o;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!(bestX+bestY) || bestX+bestY == n+m) return false;
+    *sx = bestX;
+    *sy = bestY;
+    return true;
+}
+
+static void DiffCompare(DiffCtx *c, s64 a0, s64 a1, s64 b0, s64 b1) {
+    for (;;) {
+        while (a0 < a1 && b0 < b1 && c->a[a0] == c->b[b0]) a0++, b0++;
+        while (a0 < a1 && b0 < b1 && c->a[a1-1] == c->b[b1-1]) a1--, b1--;
+
+        s64 x, y;
+        if (a0 == a1 || b0 == b1 || !DiffBisect(c, a0, a1, b0, b1, &x, &y)) {
+            memset(c->ca+a0, 1, a1-a0);
+            memset(c->cb+b0, 1, b1-b0);
+            return;
+        }
+
+        DiffCompare(c, a0, a0+x, b0, b0+y);
+        a0 += x;
+        b0 += y;
+    }
+}
+
+// Pairs up the removed and added lines of every hunk, the longer side
+// gets filler rows on the other.
+static void DiffBuildRows(Arraylist_DiffRow *out, char *ca, usize n, char *cb, usize m, u32 a0, u32 b0) {
+    usize i = 0, j = 0;
+    while (i < n || j < m) {
+        if (i < n && j < m && !ca[i] && !cb[j]) {
+            Arraylist_DiffRow_Push(out, (DiffRow){a0+i, b0+j, DiffRow_A|DiffRow_B|DiffRow_Same});
+            i++;
+            j++;
+            continue;
+        }
+
+        usize di = i, dj = j;
+        while (di < n && ca[di]) di++;
+        while (dj < m && cb[dj]) dj++;
+        if (di == i && dj == j) di++;
+
+        for (usize r = 0; i+r < di || j+r < dj; ++r) {
+            DiffRow row = {a0+di, b0+dj, 0};
+            if (i+r < di) {
+                row.a = a0+i+r;
+                row.flags |= DiffRow_A;
+            }
+            if (j+r < dj) {
+                row.b = b0+j+r;
+                row.flags |= DiffRow_B;
+            }
+            Arraylist_DiffRow_Push(out, row);
+        }
+
+        i = di;
+        j = dj;
+    }
+}
+
+// Diffs lines [a0, a1) against [b0, b1) and puts the result in place of rows [r0, r1).
+static void DiffWindow(Diff *d, usize r0, usize r1, usize a0, usize a1, usize b0, usize b1) {
+    usize n = a1-a0, m = b1-b0;
+    Resize(d->changed+0, n);
+    Resize(d->changed+1, m);
+    memset(d->changed[0].array, 0, n);
+    memset(d->changed[1].array, 0, m);
+
+    DiffCtx c = {
+        .a = d->ids[0].array+a0,
+        .b = d->ids[1].array+b0,
+        .ca = d->changed[0].array,
+        .cb = d->changed[1].array,
+        .v1 = d->v,
+        .v2 = d->v+DIFF_V_LEN,
+    };
+    DiffCompare(&c, 0, n, 0, m);
+
+    d->window.len = 0;
+    DiffBuildRows(&d->window, c.ca, n, c.cb, m, a0, b0);
+    SpliceRows(&d->rows, r0, r1-r0, d->window.array, d->window.len);
+}
+
+void DiffStart(Diff *d, Buffer *a, Buffer *b) {
+    f64 startTime = GetTime();
+    Buffer *sides[2] = {a, b};
+
+    d->used = 0;
+    if (d->values) memset(d->values, 0, d->cap*sizeof(u32));
+
+    for (usize side = 0; side < 2; ++side) {
+        Arraylist_u32 *ids = d->ids+side;
+        ids->len = 0;
+        SpliceIds(ids, 0, 0, sides[side]->lines.len);
+        DiffInternLines(d, sides[side], 0, ids->len, ids->array);
+    }
+
+    d->rows.len = 0;
+    d->viewLoc = 0;
+    DiffWindow(d, 0, 0, 0, d->ids[0].len, 0, d->ids[1].len);
+    d->active = true;
+
+    usize changed = 0;
+    for (usize i = 0; i < d->rows.len; ++i) changed += !(d->rows.array[i].flags & DiffRow_Same);
+    BufferSetMsg(a, tfmt(a->tempAlloc, "Diff: %zu changed rows (%.2fs)", changed, GetTime()-startTime));
+}
+
+static usize DiffLowerBound(Diff *d, usize side, usize line) {
+    usize lo = 0, hi = d->rows.len;
+    while (lo < hi) {
+        usize mid = lo + (hi-lo)/2;
+        if (RowCoord(d->rows.array[mid], side) < line) lo = mid+1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void DiffSyncBuffer(Diff *d, usize side, Buffer *buffer) {
+    LineEdit *e = &buffer->edit;
+    if (!d->active || !e->active) return;
+
+    usize first = e->first;
+    usize oldCount = 1;
+    for (usize i = 0; i < e->old.len; ++i) oldCount += e->old.array[i] == '\n';
+    usize newCount = e->last - e->first + 1;
+
+    // A replaced buffer is rediffed whole.
+    if (e->reset) {
+        first = 0;
+        oldCount = d->ids[side].len;
+        newCount = buffer->lines.len;
+    }
+
+    // Widen the edited lines to the rows between the closest unchanged
+    // rows around them, in coordinates from before the edit.
+    DiffRow *rows = d->rows.array;
+    usize r0 = DiffLowerBound(d, side, first);
+    while (r0 && !(rows[r0-1].flags & DiffRow_Same)) r0--;
+    usize r1 = DiffLowerBound(d, side, first+oldCount);
+    while (r1 < d->rows.len && !(rows[r1].flags & DiffRow_Same)) r1++;
+
+    usize w0[2], w1[2];
+    for (usize s = 0; s < 2; ++s) {
+        w0[s] = r0 < d->rows.len ? RowCoord(rows[r0], s) : d->ids[s].len;
+        w1[s] = r1 < d->rows.len ? RowCoord(rows[r1], s) : d->ids[s].len;
+    }
+
+    // Rows after the window move with the lines of this side.
+    for (usize r = r1; r < d->rows.len && newCount != oldCount; ++r) {
+        if (side) rows[r].b += newCount-oldCount;
+        else rows[r].a += newCount-oldCount;
+    }
+    w1[side] += newCount-oldCount;
+
+    SpliceIds(d->ids+side, first, oldCount, newCount);
+    DiffInternLines(d, buffer, first, newCount, d->ids[side].array+first);
+
+    DiffWindow(d, r0, r1, w0[0], w1[0], w0[1], w1[1]);
+}
+
+usize DiffRowOfLine(Diff *d, usize side, usize line) {
+    usize row = DiffLowerBound(d, side, line);
+    u32 flag = side ? DiffRow_B : DiffRow_A;
+    while (row < d->rows.len && !(d->rows.array[row].flags & flag)) row++;
+    return row;
+}
+
+usize DiffLineOfRow(Diff *d, usize side, usize row, usize lineCount) {
+    usize line = row < d->rows.len ? RowCoord(d->rows.array[row], side) : lineCount;
+    return line < lineCount ? line : lineCount-1;
+}
+
+// Both panes step through the same rows with the left pane's line height,
+// only the rows on screen are drawn.
+void DiffDraw(Diff *d, Buffer *a, Buffer *b) {
+    Buffer *panes[2] = {a, b};
+    f32 lineHeight = a->fontSize + a->textLineSpacing;
+
+    for (usize side = 0; side < 2; ++side) {
+        Buffer *buffer = panes[side];
+        Rectangle vp = buffer->viewport;
+        u32 flag = side ? DiffRow_B : DiffRow_A;
+        Color changed = side ? (Color){20, 60, 20, 255} : (Color){70, 20, 20, 255};
+
+        BeginScissorMode(vp.x, vp.y, vp.width, vp.height);
+        DrawRectangleRec(vp, BLACK);
+
+        usize firstRow = d->viewLoc/lineHeight;
+        usize lastRow = (d->viewLoc+vp.height)/lineHeight + 1;
+        if (lastRow > d->rows.len) lastRow = d->rows.len;
+
+        for (usize r = firstRow; r < lastRow; ++r) {
+            DiffRow row = d->rows.array[r];
+            if (row.flags & DiffRow_Same) continue;
+
+            f32 y = vp.y + floor(r*lineHeight - d->viewLoc);
+            DrawRectangle(vp.x, y, vp.width, lineHeight, (row.flags & flag) ? changed : (Color){30, 30, 30, 255});
+        }
+
+        usize cursorRow = DiffRowOfLine(d, side, buffer->cursorLine);
+        if (cursorRow >= firstRow && cursorRow < lastRow)
+            BufferDrawCursor(buffer, vp.y + cursorRow*lineHeight - d->viewLoc);
+
+        BeginBlendMode(BLEND_ALPHA);
+        for (usize r = firstRow; r < lastRow; ++r) {
+            DiffRow row = d->rows.array[r];
+            if (!(row.flags & flag)) continue;
+
+            BufferDrawLine(buffer, RowCoord(row, side), (Vector2){vp.x, vp.y + floor(r*lineHeight - d->viewLoc)});
+        }
+        EndBlendMode();
+
+        BufferDrawStatus(buffer);
+
+        EndScissorMode();
+
+        buffer->dirty = 0;
+        memClear(buffer->tempAlloc);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef _DIFF_H
+#define _DIFF_H
+
+#include "utils.h"
+#include "buffer.h"
+
+#define DIFF_MAX_COST  256 // Edit distance after which a window is split at a guess instead.
+#define DIFF_HASH_CHUNK KB(16) // Lines hashed per job.
+
+typedef enum _DiffRowFlags {
+    DiffRow_A    = 1<<0, // The row shows line a of the left buffer.
+    DiffRow_B    = 1<<1,
+    DiffRow_Same = 1<<2,
+} DiffRowFlags;
+
+// One row of the side by side view. Without a line on a side, a/b is the
+// index of that side's next line, so both stay sorted.
+typedef struct _DiffRow {
+    u32 a;
+    u32 b;
+    u32 flags;
+} DiffRow;
+
+# ifndef DIFF_ARRAYLIST
+# define DIFF_ARRAYLIST
+
+#  define T DiffRow
+#  include "arraylist.h"
+#  define T u64
+#  include "arraylist.h"
+
+# endif
+
+typedef struct _Diff {
+    b8 active;
+    f32 viewLoc; // Shared by both panes.
+
+    Arraylist_u32 ids[2]; // Interned line per buffer line.
+    Arraylist_DiffRow rows;
+
+    // Line hash to id, open addressing.
+    u64 *keys;
+    u32 *values;
+    usize cap;
+    usize used;
+
+    // Scratch for a window.
+    Arraylist_u64 hashes;
+    Arraylist_char changed[2];
+    Arraylist_DiffRow window;
+    s64 *v;
+} Diff;
+
+Diff InitDiff(void);
+void DeinitDiff(Diff *d);
+
+// Interns every line of both buffers and diffs them.
+void DiffStart(Diff *d, Buffer *a, Buffer *b);
+// Rediffs the rows around the lines the pending edit of side touched.
+void DiffSyncBuffer(Diff *d, usize side, Buffer *buffer);
+
+void DiffDraw(Diff *d, Buffer *a, Buffer *b);
+usize DiffRowOfLine(Diff *d, usize side, usize line);
+// Line shown on row, or the next line of that side when the row is filler.
+usize DiffLineOfRow(Diff *d, usize side, usize row, usize lineCount);
+
+#endif // _DIFF_H
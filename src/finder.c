@@ -0,0 +1,370 @@
+#include "finder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define FINDER_WATCH_MASK (IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO)
+#endif
+
+static s32 JoinPath(char *out, usize size, char *dir, char *name) {
+    if (!strcmp(dir, ".")) return snprintf(out, size, "%s", name);
+    return snprintf(out, size, "%s/%s", dir, name);
+}
+
+static u64 PathHash(char *path, usize len) {
+    u64 h = 14695981039346656037ULL; // FNV-1a
+    for (usize i = 0; i < len; ++i) {
+        h ^= (u8)path[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Slot of the path, or the empty slot it would go in. Called with the lock held.
+static usize FileIndexSlot(FileIndex *idx, char *path, usize len) {
+    usize at = PathHash(path, len) & (idx->slotCap-1);
+    for (; idx->slots[at]; at = (at+1) & (idx->slotCap-1)) {
+        FileEntry *e = idx->entries.array+idx->slots[at]-1;
+        if (e->len == len && !memcmp(idx->pool.array+e->offset, path, len)) break;
+    }
+    return at;
+}
+
+static void FileIndexRehash(FileIndex *idx, usize cap) {
+    memFree(TagAlloc(MemTag_Index), idx->slots);
+    idx->slots = memAlloc(TagAlloc(MemTag_Index), cap*sizeof(u32));
+    memset(idx->slots, 0, cap*sizeof(u32));
+    idx->slotCap = cap;
+
+    for (usize i = 0; i < idx->entries.len; ++i) {
+        FileEntry *e = idx->entries.array+i;
+        idx->slots[FileIndexSlot(idx, idx->pool.array+e->offset, e->len)] = i+1;
+    }
+}
+
+// Drops the removed entries and their paths. Entry ids change, so version
+// is bumped under the lock and no finder narrows with the old ones.
+static void FileIndexCompact(FileIndex *idx) {
+    usize kept = 0, pool = 0;
+    for (usize i = 0; i < idx->entries.len; ++i) {
+        FileEntry e = idx->entries.array[i];
+        if (e.removed) continue;
+
+        memmove(idx->pool.array+pool, idx->pool.array+e.offset, e.len+1);
+        e.offset = pool;
+        pool += e.len+1;
+        idx->entries.array[kept++] = e;
+    }
+    idx->entries.len = kept;
+    idx->pool.len = pool;
+    idx->removed = 0;
+    idx->version++;
+
+    FileIndexRehash(idx, idx->slotCap);
+}
+
+static void FileIndexAdd(FileIndex *idx, char *path, usize len) {
+    char *slash = strrchr(path, '/');
+
+    pthread_mutex_lock(&idx->lock);
+    if ((idx->entries.len+1)*10 > idx->slotCap*7) FileIndexRehash(idx, idx->slotCap*2);
+
+    // Saving by renaming over a file adds a path that is already there.
+    usize at = FileIndexSlot(idx, path, len);
+    if (idx->slots[at]) {
+        FileEntry *e = idx->entries.array+idx->slots[at]-1;
+        if (e->removed) idx->removed--;
+        e->removed = false;
+        pthread_mutex_unlock(&idx->lock);
+        return;
+    }
+
+    FileEntry e = {
+        .offset = idx->pool.len,
+        .len = len,
+        .name = slash ? slash-path+1 : 0,
+    };
+    for (usize i = 0; i <= len; ++i) Arraylist_char_Push(&idx->pool, path[i]);
+    Arraylist_FileEntry_Push(&idx->entries, e);
+    idx->slots[at] = idx->entries.len;
+    pthread_mutex_unlock(&idx->lock);
+}
+
+// Removes the file, or everything under it when it was a directory.
+static void FileIndexRemove(FileIndex *idx, char *path, usize len, b8 dir) {
+    pthread_mutex_lock(&idx->lock);
+    if (!dir) {
+        usize at = FileIndexSlot(idx, path, len);
+        FileEntry *e = idx->slots[at] ? idx->entries.array+idx->slots[at]-1 : NULL;
+        if (e && !e->removed) {
+            e->removed = true;
+            idx->removed++;
+        }
+    } else {
+        for (usize i = 0; i < idx->entries.len; ++i) {
+            FileEntry *e = idx->entries.array+i;
+            char *p = idx->pool.array+e->offset;
+            if (e->removed || e->len <= len || memcmp(p, path, len) || p[len] != '/') continue;
+            e->removed = true;
+            idx->removed++;
+        }
+    }
+
+    if (idx->removed*4 > idx->entries.len) FileIndexCompact(idx);
+    pthread_mutex_unlock(&idx->lock);
+}
+
+static void FileIndexWatch(FileIndex *idx, char *path) {
+#if defined(__linux__)
+    if (idx->notify < 0) return;
+
+    s32 wd = inotify_add_watch(idx->notify, path, FINDER_WATCH_MASK);
+    if (wd < 0) return;
+
+    while (idx->watches.len <= (usize)wd) Arraylist_u32_Push(&idx->watches, 0);
+    idx->watches.array[wd] = idx->watchPool.len;
+    for (char *c = path; *c; ++c) Arraylist_char_Push(&idx->watchPool, *c);
+    Arraylist_char_Push(&idx->watchPool, 0);
+#else
+    (void)idx;
+    (void)path;
+#endif
+}
+
+static void FileIndexDir(FileIndex *idx, char *path, s32 depth) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+
+    FileIndexWatch(idx, path);
+
+    struct dirent *ent;
+    while (!idx->quit && (ent = readdir(dir))) {
+        if (ent->d_name[0] == '.') continue;
+
+        char child[4096];
+        s32 len = JoinPath(child, sizeof(child), path, ent->d_name);
+        if (len >= (s32)sizeof(child)) continue;
+
+        u8 type = ent->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (lstat(child, &st)) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if (type == DT_DIR && depth < 64) FileIndexDir(idx, child, depth+1);
+        else if (type == DT_REG) FileIndexAdd(idx, child, len);
+    }
+
+    closedir(dir);
+}
+
+#if defined(__linux__)
+static void FileIndexEvents(FileIndex *idx) {
+    _Alignas(struct inotify_event) char events[KB(16)];
+
+    ssize_t n;
+    while ((n = read(idx->notify, events, sizeof(events))) > 0) {
+        for (char *at = events; at < events+n;) {
+            struct inotify_event *ev = (struct inotify_event*)at;
+            at += sizeof(*ev)+ev->len;
+
+            if (!ev->len || ev->name[0] == '.' || ev->wd < 0 || (usize)ev->wd >= idx->watches.len) continue;
+
+            char child[4096];
+            s32 len = JoinPath(child, sizeof(child), idx->watchPool.array+idx->watches.array[ev->wd], ev->name);
+            if (len >= (s32)sizeof(child)) continue;
+
+            if (ev->mask & (IN_CREATE|IN_MOVED_TO)) {
+                if (ev->mask & IN_ISDIR) FileIndexDir(idx, child, 0);
+                else FileIndexAdd(idx, child, len);
+            }
+            if (ev->mask & (IN_DELETE|IN_MOVED_FROM)) FileIndexRemove(idx, child, len, (ev->mask & IN_ISDIR) != 0);
+        }
+
+        idx->version++;
+    }
+}
+#endif
+
+static void *FileIndexWorker(void *data) {
+    FileIndex *idx = data;
+
+    FileIndexDir(idx, ".", 0);
+    idx->version++;
+    idx->building = false;
+
+#if defined(__linux__)
+    struct pollfd pfd = {.fd = idx->notify, .events = POLLIN};
+    while (!idx->quit && idx->notify >= 0) {
+        if (poll(&pfd, 1, 100) > 0) FileIndexEvents(idx);
+    }
+#endif
+
+    return NULL;
+}
+
+void InitFileIndex(FileIndex *idx) {
+    *idx = (FileIndex){
+        .notify = -1,
+        .watches = Arraylist_u32_Init(TagAlloc(MemTag_Index), 64),
+        .watchPool = Arraylist_char_Init(TagAlloc(MemTag_Index), KB(4)),
+        .entries = Arraylist_FileEntry_Init(TagAlloc(MemTag_Index), KB(1)),
+        .pool = Arraylist_char_Init(TagAlloc(MemTag_Index), KB(32)),
+        .building = true,
+    };
+    FileIndexRehash(idx, KB(4));
+    pthread_mutex_init(&idx->lock, NULL);
+
+#if defined(__linux__)
+    idx->notify = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+#endif
+
+    pthread_create(&idx->worker, NULL, FileIndexWorker, idx);
+}
+
+void DeinitFileIndex(FileIndex *idx) {
+    idx->quit = true;
+    pthread_join(idx->worker, NULL);
+
+    if (idx->notify >= 0) close(idx->notify);
+
+    Arraylist_u32_Deinit(&idx->watches);
+    Arraylist_char_Deinit(&idx->watchPool);
+    Arraylist_FileEntry_Deinit(&idx->entries);
+    Arraylist_char_Deinit(&idx->pool);
+    memFree(TagAlloc(MemTag_Index), idx->slots);
+    pthread_mutex_destroy(&idx->lock);
+}
+
+static u8 LowerTable[256];
+
+static void InitLowerTable(void) {
+    for (s32 c = 0; c < 256; ++c) LowerTable[c] = (c >= 'A' && c <= 'Z') ? c-'A'+'a' : c;
+}
+
+static b8 IsSeparator(char c) {
+    return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+// Greedy subsequence match from the end of the path so the file name gets
+// first pick, -1 when the query does not match. Hits that follow each
+// other, start a word or land in the file name score higher. query is
+// already lower case.
+static s32 FuzzyScore(u8 *query, usize qlen, u8 *path, usize len, usize name) {
+    s32 score = 0;
+    usize q = qlen;
+    usize prev = len+1;
+
+    for (usize i = len; i-- && q;) {
+        if (LowerTable[path[i]] != query[q-1]) continue;
+
+        s32 s = 1;
+        if (i+1 == prev) s += 4;
+        if (!i || IsSeparator(path[i-1])) s += 3;
+        if (i >= name) s += 2;
+
+        score += s;
+        prev = i;
+        q--;
+    }
+
+    if (q) return -1;
+
+    s32 penalty = min(len, 63); // Shorter paths win ties.
+    return score*64 - penalty;
+}
+
+Finder InitFinder(void) {
+    InitLowerTable();
+
+    Finder f = {
+        .candidates = Arraylist_u32_Init(TagAlloc(MemTag_UI), KB(1)),
+        .query = Arraylist_char_Init(TagAlloc(MemTag_UI), 64),
+    };
+    return f;
+}
+
+void DeinitFinder(Finder *f) {
+    Arraylist_u32_Deinit(&f->candidates);
+    Arraylist_char_Deinit(&f->query);
+}
+
+b8 FinderStale(Finder *f, FileIndex *idx) {
+    return f->valid && f->version != idx->version;
+}
+
+usize FinderUpdate(Finder *f, FileIndex *idx, char *query, usize len, CompletionPopup *out) {
+    out->count = 0;
+    out->selected = 0;
+    out->items.len = 0;
+    out->prefixLen = 0;
+
+    if (!len) {
+        f->valid = false;
+        return 0;
+    }
+
+    u8 lower[256];
+    len = min(len, sizeof(lower));
+    for (usize i = 0; i < len; ++i) lower[i] = LowerTable[(u8)query[i]];
+
+    pthread_mutex_lock(&idx->lock);
+
+    usize version = idx->version;
+    b8 narrow = f->valid && f->version == version &&
+        len >= f->query.len && !memcmp(query, f->query.array, f->query.len);
+    usize count = narrow ? f->candidates.len : idx->entries.len;
+
+    u32 best[COMPLETION_MAX];
+    s32 bestScore[COMPLETION_MAX];
+    usize bestCount = 0;
+
+    // Filtered in place, a match is never further along than its source.
+    usize kept = 0;
+    if (!narrow) f->candidates.len = 0;
+
+    for (usize i = 0; i < count; ++i) {
+        u32 id = narrow ? f->candidates.array[i] : i;
+        FileEntry e = idx->entries.array[id];
+        if (e.removed) continue;
+
+        s32 score = FuzzyScore(lower, len, (u8*)idx->pool.array+e.offset, e.len, e.name);
+        if (score < 0) continue;
+
+        if (narrow) f->candidates.array[kept++] = id;
+        else Arraylist_u32_Push(&f->candidates, id);
+
+        usize at = bestCount;
+        while (at && bestScore[at-1] < score) at--;
+        if (at >= COMPLETION_MAX) continue;
+
+        if (bestCount < COMPLETION_MAX) bestCount++;
+        memmove(best+at+1, best+at, (bestCount-1-at)*sizeof(*best));
+        memmove(bestScore+at+1, bestScore+at, (bestCount-1-at)*sizeof(*bestScore));
+        best[at] = id;
+        bestScore[at] = score;
+    }
+    if (narrow) f->candidates.len = kept;
+
+    for (usize i = 0; i < bestCount; ++i) {
+        FileEntry e = idx->entries.array[best[i]];
+        for (usize j = 0; j <= e.len; ++j) Arraylist_char_Push(&out->items, idx->pool.array[e.offset+j]);
+    }
+
+    pthread_mutex_unlock(&idx->lock);
+
+    f->query.len = 0;
+    for (usize i = 0; i < len; ++i) Arraylist_char_Push(&f->query, query[i]);
+    f->version = version;
+    f->valid = true;
+
+    out->count = bestCount;
+    return bestCount;
+}
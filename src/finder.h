@@ -0,0 +1,69 @@
+#ifndef _FINDER_H
+#define _FINDER_H
+
+#include "utils.h"
+#include "buffer.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct _FileEntry {
+    u32 offset; // Into the index pool.
+    u32 len;
+    u32 name;   // Where the file name starts in the path.
+    b8 removed;
+} FileEntry;
+
+# ifndef FINDER_ARRAYLIST
+# define FINDER_ARRAYLIST
+
+#  define T FileEntry
+#  include "arraylist.h"
+
+# endif
+
+// Every file under the working directory, built by a background thread
+// and kept current with inotify on Linux.
+typedef struct _FileIndex {
+    pthread_t worker;
+    _Atomic b8 quit;
+    s32 notify;
+
+    // Owned by the worker, directory path by watch descriptor.
+    Arraylist_u32 watches;
+    Arraylist_char watchPool;
+
+    // Guarded by lock.
+    pthread_mutex_t lock;
+    Arraylist_FileEntry entries;
+    Arraylist_char pool;
+    usize removed; // Entries marked removed, compacted away past a quarter.
+
+    // Path hash to entry+1, open addressing, so a path is only indexed once.
+    u32 *slots;
+    usize slotCap;
+
+    _Atomic usize version; // Bumped when entries change.
+    _Atomic b8 building; // Set until the first walk is done.
+} FileIndex;
+
+// Per keystroke state of the open prompt.
+typedef struct _Finder {
+    Arraylist_u32 candidates; // Entries matching the previous query.
+    Arraylist_char query;
+    usize version;
+    b8 valid;
+} Finder;
+
+void InitFileIndex(FileIndex *idx);
+void DeinitFileIndex(FileIndex *idx);
+
+Finder InitFinder(void);
+void DeinitFinder(Finder *f);
+
+// Ranks the index against query and puts the best paths into out. When
+// query extends the previous one only the previous candidates are scored.
+usize FinderUpdate(Finder *f, FileIndex *idx, char *query, usize len, CompletionPopup *out);
+b8 FinderStale(Finder *f, FileIndex *idx);
+
+#endif // _FINDER_H
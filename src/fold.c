@@ -0,0 +1,93 @@
+#include "fold.h"
+
+static usize FoldLen(Fold *fold) {
+    return fold->end - fold->start + 1;
+}
+
+static void FoldRebuild(Arraylist_Fold *folds) {
+    usize hidden = 0;
+    for (usize i = 0; i < folds->len; ++i) {
+        hidden += FoldLen(folds->array+i);
+        folds->array[i].hidden = hidden;
+    }
+}
+
+// Index of the last fold starting at or before line, folds->len when there is none.
+static usize FoldBefore(Arraylist_Fold *folds, usize line) {
+    usize lo = 0, hi = folds->len;
+    while (lo < hi) {
+        usize mid = lo + (hi-lo)/2;
+        if (folds->array[mid].start <= line) lo = mid+1;
+        else hi = mid;
+    }
+    return lo ? lo-1 : folds->len;
+}
+
+// Hidden lines land on the row of their header.
+usize FoldRowOfLine(Arraylist_Fold *folds, usize line) {
+    usize i = FoldBefore(folds, line);
+    if (i == folds->len) return line;
+
+    Fold *fold = folds->array+i;
+    if (line > fold->end) return line - fold->hidden;
+    return fold->start-1 - (fold->hidden - FoldLen(fold));
+}
+
+usize FoldLineOfRow(Arraylist_Fold *folds, usize row) {
+    // The first line after a fold is on row start minus what was hidden
+    // before it, those rows only grow.
+    usize lo = 0, hi = folds->len;
+    while (lo < hi) {
+        usize mid = lo + (hi-lo)/2;
+        Fold *fold = folds->array+mid;
+        if (fold->start - (fold->hidden - FoldLen(fold)) <= row) lo = mid+1;
+        else hi = mid;
+    }
+    return lo ? row + folds->array[lo-1].hidden : row;
+}
+
+usize FoldRowCount(Arraylist_Fold *folds, usize lineCount) {
+    return folds->len ? lineCount - folds->array[folds->len-1].hidden : lineCount;
+}
+
+Fold *FoldAt(Arraylist_Fold *folds, usize line) {
+    usize i = FoldBefore(folds, line);
+    if (i == folds->len || line > folds->array[i].end) return NULL;
+    return folds->array+i;
+}
+
+// Folds overlapping the new one are dropped, the ones inside it come back
+// unfolded with it.
+void FoldAdd(Arraylist_Fold *folds, usize start, usize end) {
+    usize at = 0;
+    while (at < folds->len && folds->array[at].end < start) at++;
+    while (at < folds->len && folds->array[at].start <= end) Arraylist_Fold_Remove(folds, at);
+
+    Arraylist_Fold_Insert(folds, (Fold){start, end, 0}, at);
+    FoldRebuild(folds);
+}
+
+void FoldRemove(Arraylist_Fold *folds, Fold *fold) {
+    Arraylist_Fold_Remove(folds, fold - folds->array);
+    FoldRebuild(folds);
+}
+
+void FoldShift(Arraylist_Fold *folds, usize first, usize oldCount, usize newCount) {
+    if (!folds->len) return;
+
+    usize last = first+oldCount;
+    for (usize i = 0; i < folds->len;) {
+        Fold *fold = folds->array+i;
+        if (fold->end < first) {
+            i++;
+        } else if (fold->start >= last) {
+            fold->start += newCount-oldCount;
+            fold->end += newCount-oldCount;
+            i++;
+        } else {
+            // The edit reached into the hidden lines.
+            Arraylist_Fold_Remove(folds, i);
+        }
+    }
+    FoldRebuild(folds);
+}
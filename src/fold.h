@@ -0,0 +1,28 @@
+#ifndef _FOLD_H
+#define _FOLD_H
+
+#include "utils.h"
+
+// Hidden lines [start, end], the header line start-1 stays visible.
+typedef struct _Fold {
+    usize start;
+    usize end;
+    usize hidden; // Lines hidden by this fold and all before it.
+} Fold;
+
+#define T Fold
+#include "arraylist.h"
+
+// NOTE(m1cha1s): Folds are kept sorted and disjoint, so a visible row and
+// a line map to each other with one binary search over them.
+usize FoldRowOfLine(Arraylist_Fold *folds, usize line);
+usize FoldLineOfRow(Arraylist_Fold *folds, usize row);
+usize FoldRowCount(Arraylist_Fold *folds, usize lineCount);
+Fold *FoldAt(Arraylist_Fold *folds, usize line);
+
+void FoldAdd(Arraylist_Fold *folds, usize start, usize end);
+void FoldRemove(Arraylist_Fold *folds, Fold *fold);
+// Lines [first, first+oldCount) were replaced by newCount lines.
+void FoldShift(Arraylist_Fold *folds, usize first, usize oldCount, usize newCount);
+
+#endif // _FOLD_H
@@ -0,0 +1,162 @@
+#include "fontcache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static u64 HashBytes(u8 *data, usize len) {
+    u64 h = 14695981039346656037ULL; // FNV-1a
+    for (usize i = 0; i < len; ++i) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void CachePath(char *out, usize len, u64 hash, s32 size, s32 type) {
+    char *base = getenv("XDG_CACHE_HOME");
+    char *home = getenv("HOME");
+
+    char dir[512];
+    if (base) snprintf(dir, sizeof(dir), "%s/mcoder", base);
+    else if (home) snprintf(dir, sizeof(dir), "%s/.cache/mcoder", home);
+    else snprintf(dir, sizeof(dir), ".mcoder-cache");
+
+    mkdir(dir, 0755);
+    snprintf(out, len, "%s/font-%016llx-%d-%d.atlas", dir, hash, size, type);
+}
+
+static b8 LoadFromCache(Font *font, char *cachePath, u64 hash, s32 size, s32 type) {
+    MappedFile m = MapFile(cachePath);
+    if (!m.data) return false;
+
+    FontCacheHeader *h = (FontCacheHeader*)m.data;
+
+    usize glyphsSize = 0, recsSize = 0, pixelsSize = 0;
+    b8 valid = m.size >= sizeof(*h) &&
+        h->magic == FONT_CACHE_MAGIC &&
+        h->version == FONT_CACHE_VERSION &&
+        h->fontHash == hash &&
+        h->size == size &&
+        h->type == type &&
+        h->glyphCount > 0;
+
+    if (valid) {
+        glyphsSize = h->glyphCount*sizeof(FontCacheGlyph);
+        recsSize = h->glyphCount*sizeof(Rectangle);
+        pixelsSize = GetPixelDataSize(h->atlasWidth, h->atlasHeight, h->atlasFormat);
+        valid = m.size == sizeof(*h) + glyphsSize + recsSize + pixelsSize;
+    }
+
+    if (!valid) {
+        UnmapFile(m);
+        return false;
+    }
+
+    FontCacheGlyph *glyphs = (FontCacheGlyph*)(m.data + sizeof(*h));
+    Rectangle *recs = (Rectangle*)(m.data + sizeof(*h) + glyphsSize);
+    u8 *pixels = m.data + sizeof(*h) + glyphsSize + recsSize;
+
+    // Allocated with raylib's allocator so UnloadFont can free them.
+    font->baseSize = size;
+    font->glyphCount = h->glyphCount;
+    font->glyphs = MemAlloc(h->glyphCount*sizeof(GlyphInfo));
+    font->recs = MemAlloc(recsSize);
+
+    for (s32 i = 0; i < h->glyphCount; ++i) {
+        font->glyphs[i] = (GlyphInfo){
+            .value = glyphs[i].value,
+            .offsetX = glyphs[i].offsetX,
+            .offsetY = glyphs[i].offsetY,
+            .advanceX = glyphs[i].advanceX,
+        };
+    }
+    memcpy(font->recs, recs, recsSize);
+
+    Image atlas = {
+        .data = pixels,
+        .width = h->atlasWidth,
+        .height = h->atlasHeight,
+        .mipmaps = 1,
+        .format = h->atlasFormat,
+    };
+    font->texture = LoadTextureFromImage(atlas);
+
+    UnmapFile(m);
+    return true;
+}
+
+static void StoreInCache(Font font, Image atlas, char *cachePath, u64 hash, s32 size, s32 type) {
+    char tmpPath[600];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", cachePath);
+
+    FILE *file = fopen(tmpPath, "wb");
+    if (!file) return;
+
+    FontCacheHeader h = {
+        .magic = FONT_CACHE_MAGIC,
+        .version = FONT_CACHE_VERSION,
+        .fontHash = hash,
+        .size = size,
+        .type = type,
+        .glyphCount = font.glyphCount,
+        .atlasWidth = atlas.width,
+        .atlasHeight = atlas.height,
+        .atlasFormat = atlas.format,
+    };
+    fwrite(&h, sizeof(h), 1, file);
+
+    for (s32 i = 0; i < font.glyphCount; ++i) {
+        FontCacheGlyph g = {
+            .value = font.glyphs[i].value,
+            .offsetX = font.glyphs[i].offsetX,
+            .offsetY = font.glyphs[i].offsetY,
+            .advanceX = font.glyphs[i].advanceX,
+        };
+        fwrite(&g, sizeof(g), 1, file);
+    }
+    fwrite(font.recs, sizeof(Rectangle), font.glyphCount, file);
+    fwrite(atlas.data, GetPixelDataSize(atlas.width, atlas.height, atlas.format), 1, file);
+
+    b8 ok = !ferror(file);
+    fclose(file);
+
+    // Rename last so a reader never sees a half written entry.
+    if (ok) rename(tmpPath, cachePath);
+    else remove(tmpPath);
+}
+
+Font LoadFontCached(char *path, s32 size, s32 type) {
+    Font font = {0};
+
+    MappedFile ttf = MapFile(path);
+    if (!ttf.data) {
+        TraceLog(LOG_WARNING, "FONT: [%s] Failed to open font file", path);
+        return GetFontDefault();
+    }
+
+    u64 hash = HashBytes(ttf.data, ttf.size);
+
+    char cachePath[512];
+    CachePath(cachePath, sizeof(cachePath), hash, size, type);
+
+    if (LoadFromCache(&font, cachePath, hash, size, type)) {
+        UnmapFile(ttf);
+        return font;
+    }
+
+    font.baseSize = size;
+    font.glyphCount = FONT_CACHE_GLYPHS;
+    font.glyphs = LoadFontData(ttf.data, ttf.size, size, 0, 0, type);
+
+    Image atlas = GenImageFontAtlas(font.glyphs, &font.recs, FONT_CACHE_GLYPHS, size, 1, 1);
+    font.texture = LoadTextureFromImage(atlas);
+
+    StoreInCache(font, atlas, cachePath, hash, size, type);
+
+    UnloadImage(atlas);
+    UnmapFile(ttf);
+
+    return font;
+}
@@ -0,0 +1,36 @@
+#ifndef _FONTCACHE_H
+#define _FONTCACHE_H
+
+#include "utils.h"
+
+#include <raylib.h>
+
+#define FONT_CACHE_MAGIC   0x4146434D // "MCFA"
+#define FONT_CACHE_VERSION 1
+#define FONT_CACHE_GLYPHS  95
+
+// On disk: header, glyph metrics, glyph rectangles, atlas pixels.
+typedef struct _FontCacheHeader {
+    u32 magic;
+    u32 version;
+    u64 fontHash;
+    s32 size;
+    s32 type;
+    s32 glyphCount;
+    s32 atlasWidth;
+    s32 atlasHeight;
+    s32 atlasFormat;
+} FontCacheHeader;
+
+typedef struct _FontCacheGlyph {
+    s32 value;
+    s32 offsetX;
+    s32 offsetY;
+    s32 advanceX;
+} FontCacheGlyph;
+
+// Loads the font from the baked atlas cache, rasterizing and storing it
+// when there is no cache entry for this font file, size and type.
+Font LoadFontCached(char *path, s32 size, s32 type);
+
+#endif // _FONTCACHE_H
@@ -0,0 +1,556 @@
+#include "grep.h"
+#include "ingest.h"
+#include "jobs.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+void InitGrep(Grep *g) {
+    *g = (Grep){
+        .workerCount = min(WorkerCount(), GREP_MAX_WORKERS),
+        .text = Arraylist_char_Init(TagAlloc(MemTag_Index), KB(4)),
+        .hits = Arraylist_GrepHit_Init(TagAlloc(MemTag_Index), 64),
+        .drainText = Arraylist_char_Init(TagAlloc(MemTag_Index), KB(4)),
+        .drainHits = Arraylist_GrepHit_Init(TagAlloc(MemTag_Index), 64),
+        .decoded = Arraylist_s32_Init(TagAlloc(MemTag_Index), KB(4)),
+        .matches = Arraylist_Diagnostic_Init(TagAlloc(MemTag_Lines), 64),
+        .paths = Arraylist_char_Init(TagAlloc(MemTag_Lines), KB(1)),
+    };
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_mutex_init(&g->idleLock, NULL);
+    pthread_cond_init(&g->idle, NULL);
+
+    for (usize i = 0; i < g->workerCount; ++i) {
+        GrepWorker *w = g->workers+i;
+        w->grep = g;
+        w->tasks = Arraylist_GrepTask_Init(TagAlloc(MemTag_Index), 64);
+        w->text = Arraylist_char_Init(TagAlloc(MemTag_Index), KB(1));
+        w->hits = Arraylist_GrepHit_Init(TagAlloc(MemTag_Index), 16);
+        pthread_mutex_init(&w->lock, NULL);
+    }
+}
+
+void DeinitGrep(Grep *g) {
+    GrepStop(g);
+
+    for (usize i = 0; i < g->workerCount; ++i) {
+        GrepWorker *w = g->workers+i;
+        Arraylist_GrepTask_Deinit(&w->tasks);
+        Arraylist_char_Deinit(&w->text);
+        Arraylist_GrepHit_Deinit(&w->hits);
+        pthread_mutex_destroy(&w->lock);
+    }
+
+    Arraylist_char_Deinit(&g->text);
+    Arraylist_GrepHit_Deinit(&g->hits);
+    Arraylist_char_Deinit(&g->drainText);
+    Arraylist_GrepHit_Deinit(&g->drainHits);
+    Arraylist_s32_Deinit(&g->decoded);
+    Arraylist_Diagnostic_Deinit(&g->matches);
+    Arraylist_char_Deinit(&g->paths);
+    pthread_mutex_destroy(&g->lock);
+    pthread_mutex_destroy(&g->idleLock);
+    pthread_cond_destroy(&g->idle);
+}
+
+static void PushBytes(Arraylist_char *al, char *data, usize len) {
+    for (usize i = 0; i < len; ++i) Arraylist_char_Push(al, data[i]);
+}
+
+// Wakes idle workers, for new work or to let them see they are done.
+static void GrepWake(Grep *g, b8 all) {
+    pthread_mutex_lock(&g->idleLock);
+    if (all) pthread_cond_broadcast(&g->idle);
+    else pthread_cond_signal(&g->idle);
+    pthread_mutex_unlock(&g->idleLock);
+}
+
+static void GrepPush(GrepWorker *w, char *path, usize len, b8 dir) {
+    GrepTask task = {
+        .path = memAlloc(TagAlloc(MemTag_Index), len+1),
+        .dir = dir,
+    };
+    memcpy(task.path, path, len);
+    task.path[len] = 0;
+
+    atomic_fetch_add(&w->grep->pending, 1);
+
+    pthread_mutex_lock(&w->lock);
+    Arraylist_GrepTask_Push(&w->tasks, task);
+    pthread_mutex_unlock(&w->lock);
+
+    atomic_fetch_add(&w->grep->queued, 1);
+    GrepWake(w->grep, false);
+}
+
+// Newest task first, keeps the walk depth first and the deque short.
+static b8 GrepPop(GrepWorker *w, GrepTask *task) {
+    b8 found = false;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->tasks.len > w->top) {
+        *task = w->tasks.array[--w->tasks.len];
+        found = true;
+    }
+    if (w->tasks.len == w->top) w->tasks.len = w->top = 0;
+    pthread_mutex_unlock(&w->lock);
+
+    if (found) atomic_fetch_sub(&w->grep->queued, 1);
+    return found;
+}
+
+// Oldest task of a victim, those are closest to the root and have the
+// most work under them.
+static b8 GrepSteal(GrepWorker *w, GrepTask *task) {
+    Grep *g = w->grep;
+    usize self = w-g->workers;
+
+    for (usize k = 1; k < g->workerCount; ++k) {
+        GrepWorker *v = g->workers + (self+k) % g->workerCount;
+        b8 found = false;
+
+        pthread_mutex_lock(&v->lock);
+        if (v->tasks.len > v->top) {
+            *task = v->tasks.array[v->top++];
+            found = true;
+        }
+        if (v->tasks.len == v->top) v->tasks.len = v->top = 0;
+        pthread_mutex_unlock(&v->lock);
+
+        if (found) {
+            atomic_fetch_sub(&g->queued, 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static u8 *FindLiteral(u8 *hay, usize len, u8 *needle, usize n) {
+    if (!n || n > len) return NULL;
+    usize i = 0;
+
+    // Compare the first and last byte of the needle at 16 positions at once,
+    // memcmp only where both hit.
+#if defined(__SSE2__)
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[n-1]);
+    for (; i+n-1+16 <= len; i += 16) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)(hay+i)), first);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)(hay+i+n-1)), last);
+        u32 mask = _mm_movemask_epi8(_mm_and_si128(a, b));
+        while (mask) {
+            u32 bit = __builtin_ctz(mask);
+            if (!memcmp(hay+i+bit, needle, n)) return hay+i+bit;
+            mask &= mask-1;
+        }
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t first = vdupq_n_u8(needle[0]);
+    uint8x16_t last = vdupq_n_u8(needle[n-1]);
+    for (; i+n-1+16 <= len; i += 16) {
+        uint8x16_t a = vceqq_u8(vld1q_u8(hay+i), first);
+        uint8x16_t b = vceqq_u8(vld1q_u8(hay+i+n-1), last);
+        if (!vmaxvq_u8(vandq_u8(a, b))) continue;
+        for (usize bit = 0; bit < 16; ++bit)
+            if (!memcmp(hay+i+bit, needle, n)) return hay+i+bit;
+    }
+#endif
+
+    for (; i+n <= len; ++i)
+        if (hay[i] == needle[0] && !memcmp(hay+i, needle, n)) return hay+i;
+    return NULL;
+}
+
+// Small regex subset: . * ^ $ and \ to escape.
+static void GrepCompile(Grep *g, char *re) {
+    g->atomCount = 0;
+    g->anchorStart = re[0] == '^';
+    g->anchorEnd = false;
+    if (g->anchorStart) re++;
+
+    while (*re) {
+        if (re[0] == '$' && !re[1]) {
+            g->anchorEnd = true;
+            break;
+        }
+
+        GrepAtom a = {0};
+        if (re[0] == '\\' && re[1]) {
+            a.c = re[1];
+            re += 2;
+        } else {
+            a.any = re[0] == '.';
+            a.c = re[0];
+            re++;
+        }
+        if (*re == '*') {
+            a.star = true;
+            re++;
+        }
+        g->atoms[g->atomCount++] = a;
+    }
+
+    // Atoms that are neither . nor repeated have to show up in order.
+    g->literalLen = 0;
+    for (usize i = 0; i < g->atomCount;) {
+        usize j = i;
+        while (j < g->atomCount && !g->atoms[j].any && !g->atoms[j].star) j++;
+        if (j-i > g->literalLen) {
+            g->literalLen = j-i;
+            for (usize k = i; k < j; ++k) g->literal[k-i] = g->atoms[k].c;
+        }
+        i = j+1;
+    }
+}
+
+// Puts state i and the states after the repeated atoms it can skip in the
+// set, keeping the leftmost start of each.
+static void GrepAddState(Grep *g, s64 *set, usize i, s64 start) {
+    for (;;) {
+        if (set[i] >= 0 && set[i] <= start) return;
+        set[i] = start;
+        if (i == g->atomCount || !g->atoms[i].star) return;
+        i++;
+    }
+}
+
+// Column of the leftmost match in the line or -1. Runs every start at once
+// over the atoms, so it never backtracks and is linear in the line.
+static s64 MatchRegex(Grep *g, u8 *text, u8 *end) {
+    s64 sets[2][GREP_MAX_PATTERN+1];
+    s64 *cur = sets[0], *next = sets[1];
+    usize count = g->atomCount;
+    for (usize i = 0; i <= count; ++i) cur[i] = -1;
+
+    s64 best = -1;
+    for (u8 *at = text;; ++at) {
+        if (best < 0 && (!g->anchorStart || at == text)) GrepAddState(g, cur, 0, at-text);
+
+        s64 done = cur[count];
+        if (done >= 0 && (!g->anchorEnd || at == end) && (best < 0 || done < best)) best = done;
+        if (at == end) break;
+
+        for (usize i = 0; i <= count; ++i) next[i] = -1;
+        b8 alive = false;
+        for (usize i = 0; i < count; ++i) {
+            GrepAtom a = g->atoms[i];
+            if (cur[i] < 0 || (!a.any && a.c != *at)) continue;
+            // A later start can no longer beat the match we have.
+            if (best >= 0 && cur[i] >= best) continue;
+
+            GrepAddState(g, next, a.star ? i : i+1, cur[i]);
+            alive = true;
+        }
+
+        s64 *t = cur;
+        cur = next;
+        next = t;
+        if (!alive && (best >= 0 || g->anchorStart)) break;
+    }
+    return best;
+}
+
+// byteCol is one based, the column reported counts codepoints like the buffers do.
+static void GrepEmit(GrepWorker *w, char *path, usize line, usize byteCol, u8 *text, usize len) {
+    usize col = 1;
+    for (usize i = 0; i+1 < byteCol; ++i) col += (text[i] & 0xC0) != 0x80;
+
+    GrepHit hit = {
+        .textOffset = w->text.len,
+        .pathLen = strlen(path),
+        .line = line,
+        .col = col,
+    };
+    Arraylist_GrepHit_Push(&w->hits, hit);
+
+    char head[64];
+    s32 headLen = snprintf(head, sizeof(head), ":%zu:%zu: ", line, col);
+    PushBytes(&w->text, path, hit.pathLen);
+    PushBytes(&w->text, head, headLen);
+
+    // Cut on a UTF-8 boundary.
+    if (len > GREP_MAX_LINE) {
+        len = GREP_MAX_LINE;
+        while (len && (text[len] & 0xC0) == 0x80) len--;
+    }
+    for (usize i = 0; i < len; ++i) Arraylist_char_Push(&w->text, text[i] < ' ' ? ' ' : text[i]);
+    Arraylist_char_Push(&w->text, '\n');
+}
+
+static void GrepFile(GrepWorker *w, char *path) {
+    Grep *g = w->grep;
+
+    MappedFile m = MapFile(path);
+    if (!m.data) return;
+
+    u8 *data = m.data, *end = m.data+m.size;
+    atomic_fetch_add(&g->fileCount, 1);
+
+    // Skip binaries.
+    if (memchr(data, 0, min(m.size, KB(4)))) {
+        UnmapFile(m);
+        return;
+    }
+
+    u8 *needle = (u8*)(g->regex ? g->literal : g->pattern);
+    usize n = g->regex ? g->literalLen : g->patternLen;
+
+    if (!n) {
+        usize line = 1;
+        for (u8 *ls = data; ls < end && !g->stop; ++line) {
+            u8 *le = memchr(ls, '\n', end-ls);
+            if (!le) le = end;
+
+            s64 col = MatchRegex(g, ls, le);
+            if (col >= 0) GrepEmit(w, path, line, col+1, ls, le-ls);
+
+            ls = le+1;
+        }
+    } else {
+        // A regex only runs on the lines that have its literal.
+        usize line = 1;
+        u8 *counted = data;
+        for (u8 *at = data; at < end && !g->stop;) {
+            u8 *found = FindLiteral(at, end-at, needle, n);
+            if (!found) break;
+
+            line += CountNewlines(counted, found-counted);
+            counted = found;
+
+            u8 *ls = found;
+            while (ls > data && ls[-1] != '\n') ls--;
+            u8 *le = memchr(found, '\n', end-found);
+            if (!le) le = end;
+
+            s64 col = g->regex ? MatchRegex(g, ls, le) : found-ls;
+            if (col >= 0) GrepEmit(w, path, line, col+1, ls, le-ls);
+            at = le+1; // One result per line.
+        }
+    }
+
+    UnmapFile(m);
+
+    if (!w->hits.len) return;
+
+    pthread_mutex_lock(&g->lock);
+    usize offset = g->text.len;
+    PushBytes(&g->text, w->text.array, w->text.len);
+    for (usize i = 0; i < w->hits.len; ++i) {
+        GrepHit hit = w->hits.array[i];
+        hit.textOffset += offset;
+        Arraylist_GrepHit_Push(&g->hits, hit);
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    if (atomic_fetch_add(&g->matchCount, w->hits.len)+w->hits.len >= GREP_MAX_MATCHES) {
+        g->stop = true;
+        GrepWake(g, true);
+    }
+
+    w->text.len = 0;
+    w->hits.len = 0;
+}
+
+static void GrepDir(GrepWorker *w, char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+
+    b8 cwd = !strcmp(path, ".");
+
+    struct dirent *ent;
+    while (!w->grep->stop && (ent = readdir(dir))) {
+        if (ent->d_name[0] == '.') continue;
+
+        char child[4096];
+        s32 len = cwd ? snprintf(child, sizeof(child), "%s", ent->d_name)
+                      : snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+        if (len >= (s32)sizeof(child)) continue;
+
+        u8 type = ent->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (lstat(child, &st)) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if (type == DT_DIR) GrepPush(w, child, len, true);
+        else if (type == DT_REG) GrepPush(w, child, len, false);
+    }
+
+    closedir(dir);
+}
+
+static void *GrepWorkerProc(void *data) {
+    GrepWorker *w = data;
+    Grep *g = w->grep;
+
+    while (!g->stop && atomic_load(&g->pending)) {
+        GrepTask task;
+        if (!GrepPop(w, &task) && !GrepSteal(w, &task)) {
+            // Checked under the lock, a push signals only after queued went up.
+            pthread_mutex_lock(&g->idleLock);
+            while (!g->stop && atomic_load(&g->pending) && !atomic_load(&g->queued))
+                pthread_cond_wait(&g->idle, &g->idleLock);
+            pthread_mutex_unlock(&g->idleLock);
+            continue;
+        }
+
+        if (task.dir) GrepDir(w, task.path);
+        else GrepFile(w, task.path);
+
+        memFree(TagAlloc(MemTag_Index), task.path);
+        if (atomic_fetch_sub(&g->pending, 1) == 1) GrepWake(g, true);
+    }
+
+    atomic_fetch_sub(&g->alive, 1);
+    return NULL;
+}
+
+s32 GrepStart(Grep *g, Buffer *out, char *root, char *pattern, usize patternLen) {
+    GrepStop(g);
+
+    BufferClear(out);
+    out->mode = BMode_Grep;
+
+    if (!patternLen || patternLen >= GREP_MAX_PATTERN) {
+        BufferSetMsg(out, "Invalid pattern");
+        return -1;
+    }
+
+    g->regex = pattern[0] == '/';
+    if (g->regex) {
+        pattern++;
+        patternLen--;
+    }
+    if (!patternLen) {
+        BufferSetMsg(out, "Invalid pattern");
+        return -1;
+    }
+
+    memcpy(g->pattern, pattern, patternLen);
+    g->pattern[patternLen] = 0;
+    g->patternLen = patternLen;
+    if (g->regex) GrepCompile(g, g->pattern);
+
+    g->stop = false;
+    g->queued = 0;
+    g->matchCount = 0;
+    g->fileCount = 0;
+    g->text.len = 0;
+    g->hits.len = 0;
+    g->matches.len = 0;
+    g->paths.len = 0;
+    g->startTime = GetTime();
+
+    GrepPush(g->workers, root, strlen(root), true);
+
+    g->alive = g->workerCount;
+    for (g->threadCount = 0; g->threadCount < g->workerCount; ++g->threadCount)
+        if (pthread_create(&g->workers[g->threadCount].thread, NULL, GrepWorkerProc, g->workers+g->threadCount)) break;
+    g->alive -= g->workerCount - g->threadCount;
+
+    g->running = true;
+    out->busy = true;
+    BufferSetMsg(out, "Searching...");
+
+    return 0;
+}
+
+static void GrepJoin(Grep *g) {
+    for (usize i = 0; i < g->threadCount; ++i) pthread_join(g->workers[i].thread, NULL);
+
+    for (usize i = 0; i < g->workerCount; ++i) {
+        GrepWorker *w = g->workers+i;
+
+        // Left over when stopped early.
+        for (usize k = w->top; k < w->tasks.len; ++k)
+            memFree(TagAlloc(MemTag_Index), w->tasks.array[k].path);
+        w->tasks.len = w->top = 0;
+        w->text.len = 0;
+        w->hits.len = 0;
+    }
+    g->pending = 0;
+    g->queued = 0;
+    g->running = false;
+}
+
+void GrepStop(Grep *g) {
+    if (!g->running) return;
+    g->stop = true;
+    GrepWake(g, true);
+    GrepJoin(g);
+}
+
+void GrepUpdate(Grep *g, Buffer *out) {
+    if (!g->running) return;
+
+    // Read before draining so nothing found after the check is lost.
+    b8 done = !atomic_load(&g->alive);
+
+    pthread_mutex_lock(&g->lock);
+    Arraylist_char text = g->text;
+    Arraylist_GrepHit hits = g->hits;
+    g->text = g->drainText;
+    g->hits = g->drainHits;
+    pthread_mutex_unlock(&g->lock);
+
+    if (hits.len) {
+        g->decoded.len = 0;
+        for (usize i = 0; i < text.len;) {
+            s32 cps = 0;
+            Arraylist_s32_Push(&g->decoded, GetCodepointNext(text.array+i, &cps));
+            i += cps;
+        }
+
+        // Every hit is one line.
+        usize firstLine = out->lines.len-1;
+        BufferAppend(out, g->decoded.array, g->decoded.len);
+
+        for (usize i = 0; i < hits.len; ++i) {
+            GrepHit hit = hits.array[i];
+            Diagnostic d = {
+                .logLine = firstLine+i,
+                .pathStart = g->paths.len,
+                .pathLen = hit.pathLen,
+                .line = hit.line,
+                .col = hit.col,
+            };
+            PushBytes(&g->paths, text.array+hit.textOffset, hit.pathLen);
+            Arraylist_char_Push(&g->paths, 0);
+            Arraylist_Diagnostic_Push(&g->matches, d);
+        }
+    }
+
+    text.len = 0;
+    hits.len = 0;
+    g->drainText = text;
+    g->drainHits = hits;
+
+    if (done) {
+        b8 truncated = g->stop;
+        GrepJoin(g);
+        out->busy = false;
+
+        BufferSetMsg(out, tfmt(out->tempAlloc, "%zu matches in %zu files%s (%.2fs)",
+                               g->matches.len, atomic_load(&g->fileCount),
+                               truncated ? ", stopped" : "", GetTime()-g->startTime));
+    }
+}
+
+Diagnostic *GrepMatchAt(Grep *g, usize line) {
+    if (line >= g->matches.len) return NULL;
+    return g->matches.array+line;
+}
+
+char *GrepMatchPath(Grep *g, Diagnostic *d) {
+    return g->paths.array+d->pathStart;
+}
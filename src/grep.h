@@ -0,0 +1,117 @@
+#ifndef _GREP_H
+#define _GREP_H
+
+#include "utils.h"
+#include "buffer.h"
+#include "compile.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define GREP_MAX_WORKERS 64
+#define GREP_MAX_PATTERN 256
+#define GREP_MAX_MATCHES 100000
+#define GREP_MAX_LINE    256 // Longer matching lines are cut in the results.
+
+typedef struct _GrepTask {
+    char *path;
+    b8 dir;
+} GrepTask;
+
+// One step of a regex, a character or any character, optionally repeated.
+typedef struct _GrepAtom {
+    u8 c;
+    b8 any;
+    b8 star;
+} GrepAtom;
+
+// A result line in the worker's output, the line starts with the path.
+typedef struct _GrepHit {
+    usize textOffset;
+    usize pathLen;
+    s32 line;
+    s32 col;
+} GrepHit;
+
+# ifndef GREP_ARRAYLIST
+# define GREP_ARRAYLIST
+
+#  define T GrepTask
+#  include "arraylist.h"
+#  define T GrepHit
+#  include "arraylist.h"
+
+# endif
+
+struct _Grep;
+
+typedef struct _GrepWorker {
+    struct _Grep *grep;
+    pthread_t thread;
+
+    // The owner pushes and pops at the end, thieves take from top.
+    pthread_mutex_t lock;
+    Arraylist_GrepTask tasks;
+    usize top;
+
+    // Results of the file being searched.
+    Arraylist_char text;
+    Arraylist_GrepHit hits;
+} GrepWorker;
+
+typedef struct _Grep {
+    GrepWorker workers[GREP_MAX_WORKERS];
+    usize workerCount;
+    usize threadCount; // Workers that actually got a thread.
+
+    _Atomic usize pending; // Tasks queued or in progress.
+    _Atomic usize queued;  // Tasks in a deque, idle workers sleep while it is 0.
+    _Atomic usize alive;
+    _Atomic b8 stop;
+    b8 running;
+
+    pthread_mutex_t idleLock;
+    pthread_cond_t idle;
+
+    char pattern[GREP_MAX_PATTERN];
+    usize patternLen;
+
+    b8 regex;
+    b8 anchorStart;
+    b8 anchorEnd;
+    GrepAtom atoms[GREP_MAX_PATTERN];
+    usize atomCount;
+    // Longest run of atoms every match contains, lines without it are skipped.
+    char literal[GREP_MAX_PATTERN];
+    usize literalLen;
+
+    // Results not yet in the buffer, guarded by lock.
+    pthread_mutex_t lock;
+    Arraylist_char text;
+    Arraylist_GrepHit hits;
+    _Atomic usize matchCount;
+    _Atomic usize fileCount;
+
+    // Owned by the UI thread.
+    Arraylist_char drainText;
+    Arraylist_GrepHit drainHits;
+    Arraylist_s32 decoded;
+    Arraylist_Diagnostic matches; // One per result line.
+    Arraylist_char paths;
+
+    f64 startTime;
+} Grep;
+
+void InitGrep(Grep *g);
+void DeinitGrep(Grep *g);
+
+// Searches every file under root for pattern, a literal unless it starts
+// with '/'. The rest is then a regex of . * ^ $ and \ to escape.
+s32 GrepStart(Grep *g, Buffer *out, char *root, char *pattern, usize patternLen);
+void GrepUpdate(Grep *g, Buffer *out);
+void GrepStop(Grep *g);
+
+Diagnostic *GrepMatchAt(Grep *g, usize line);
+char *GrepMatchPath(Grep *g, Diagnostic *d);
+
+#endif // _GREP_H
@@ -0,0 +1,208 @@
+#include "ingest.h"
+#include "jobs.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef struct _IngestChunk {
+    u8 *data;
+    usize len;
+
+    usize textLen;
+    usize newlineCount;
+
+    usize textOffset; // Prefix sums of the counts above.
+    usize lineOffset;
+} IngestChunk;
+
+typedef struct _Ingest {
+    Buffer *buffer;
+    IngestChunk *chunks;
+} Ingest;
+
+usize CountNewlines(u8 *data, usize len) {
+    usize count = 0;
+    usize i = 0;
+
+#if defined(__SSE2__)
+    __m128i nl = _mm_set1_epi8('\n');
+    for (; i+16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((__m128i*)(data+i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t nl = vdupq_n_u8('\n');
+    uint8x16_t one = vdupq_n_u8(1);
+    for (; i+16 <= len; i += 16) {
+        uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(data+i), nl), one);
+        count += vaddvq_u8(eq);
+    }
+#endif
+
+    for (; i < len; ++i) count += data[i] == '\n';
+    return count;
+}
+
+// Like raylib's GetCodepointNext, invalid bytes decode to '?' one at a time.
+// Overlong forms, surrogates and anything past U+10FFFF count as invalid, so
+// '\n' only ever comes from a raw 0x0A, which is what CountNewlines sees.
+static usize DecodeUtf8(u8 *p, usize left, s32 *codepoint) {
+    u8 c = p[0];
+
+    if (c < 0x80) {
+        *codepoint = c;
+        return 1;
+    }
+
+    s32 cp = 0;
+    usize len = 0;
+    if ((c & 0xE0) == 0xC0 && left >= 2 && (p[1] & 0xC0) == 0x80) {
+        cp = ((c & 0x1F) << 6) | (p[1] & 0x3F);
+        len = cp >= 0x80 ? 2 : 0;
+    } else if ((c & 0xF0) == 0xE0 && left >= 3 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80) {
+        cp = ((c & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+        len = cp >= 0x800 && (cp < 0xD800 || cp > 0xDFFF) ? 3 : 0;
+    } else if ((c & 0xF8) == 0xF0 && left >= 4 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80 && (p[3] & 0xC0) == 0x80) {
+        cp = ((c & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+        len = cp >= 0x10000 && cp <= 0x10FFFF ? 4 : 0;
+    }
+
+    if (!len) {
+        *codepoint = '?';
+        return 1;
+    }
+
+    *codepoint = cp;
+    return len;
+}
+
+static b8 IsAscii16(u8 *p) {
+#if defined(__SSE2__)
+    return !_mm_movemask_epi8(_mm_loadu_si128((__m128i*)p));
+#elif defined(__ARM_NEON)
+    return vmaxvq_u8(vld1q_u8(p)) < 0x80;
+#else
+    u64 a, b;
+    memcpy(&a, p, 8);
+    memcpy(&b, p+8, 8);
+    return !((a|b) & 0x8080808080808080ULL);
+#endif
+}
+
+// First pass, only counts so the second pass can write in place.
+static void IngestCountChunk(void *data, usize i) {
+    IngestChunk *chunk = ((Ingest*)data)->chunks+i;
+
+    usize textLen = 0;
+    for (usize at = 0; at < chunk->len;) {
+        if (at+16 <= chunk->len && IsAscii16(chunk->data+at)) {
+            at += 16;
+            textLen += 16;
+            continue;
+        }
+
+        s32 codepoint;
+        at += DecodeUtf8(chunk->data+at, chunk->len-at, &codepoint);
+        textLen++;
+    }
+
+    chunk->textLen = textLen;
+    chunk->newlineCount = CountNewlines(chunk->data, chunk->len);
+}
+
+static void IngestDecodeChunk(void *data, usize i) {
+    Ingest *ingest = data;
+    IngestChunk *chunk = ingest->chunks+i;
+    Buffer *buffer = ingest->buffer;
+
+    s32 *text = buffer->buffer.array+chunk->textOffset;
+    // Newline k ends line lineOffset+k and starts the next one.
+    Line *lines = buffer->lines.array+chunk->lineOffset;
+
+    usize textLen = 0;
+    usize newlines = 0;
+    for (usize at = 0; at < chunk->len;) {
+        s32 codepoint;
+        at += DecodeUtf8(chunk->data+at, chunk->len-at, &codepoint);
+
+        if (codepoint == '\n') {
+            usize pos = chunk->textOffset+textLen;
+            lines[newlines].end = pos;
+            lines[newlines+1].start = pos+1;
+            newlines++;
+        }
+        text[textLen++] = codepoint;
+    }
+}
+
+static void ReserveExact(Arraylist_s32 *al, usize len) {
+    if (al->cap >= len) return;
+    Alloc alloc = al->alloc;
+    Arraylist_s32_Deinit(al);
+    *al = Arraylist_s32_Init(alloc, len);
+}
+
+void IngestBuffer(Buffer *buffer, u8 *data, usize len) {
+    if (!len) {
+        BufferClear(buffer);
+        return;
+    }
+
+    BufferResetEdit(buffer);
+
+    usize chunkCount = (len + INGEST_CHUNK_SIZE-1) / INGEST_CHUNK_SIZE;
+    IngestChunk *chunks = memAlloc(TagAlloc(MemTag_Temp), chunkCount*sizeof(IngestChunk));
+
+    // Move every boundary past continuation bytes so no UTF-8 sequence is
+    // split between two chunks.
+    usize start = 0;
+    for (usize i = 0; i < chunkCount; ++i) {
+        usize end = (i+1)*INGEST_CHUNK_SIZE;
+        if (end >= len) end = len;
+        else for (usize k = 0; k < 3 && end < len && (data[end] & 0xC0) == 0x80; ++k) end++;
+
+        chunks[i] = (IngestChunk){.data = data+start, .len = end-start};
+        start = end;
+    }
+
+    Ingest ingest = {.buffer = buffer, .chunks = chunks};
+    ParallelFor(chunkCount, IngestCountChunk, &ingest);
+
+    usize textLen = 0;
+    usize lineCount = 0;
+    for (usize i = 0; i < chunkCount; ++i) {
+        chunks[i].textOffset = textLen;
+        chunks[i].lineOffset = lineCount;
+        textLen += chunks[i].textLen;
+        lineCount += chunks[i].newlineCount;
+    }
+    lineCount++; // The line after the last newline.
+
+    ReserveExact(&buffer->buffer, textLen);
+    buffer->buffer.len = textLen;
+
+    if (buffer->lines.cap < lineCount) {
+        Alloc alloc = buffer->lines.alloc;
+        Arraylist_Line_Deinit(&buffer->lines);
+        buffer->lines = Arraylist_Line_Init(alloc, lineCount);
+    }
+    buffer->lines.len = lineCount;
+    buffer->lines.array[0].start = 0;
+    buffer->lines.array[lineCount-1].end = textLen;
+
+    ParallelFor(chunkCount, IngestDecodeChunk, &ingest);
+
+    memFree(TagAlloc(MemTag_Temp), chunks);
+
+    buffer->edit.last = buffer->lines.len-1;
+    buffer->cursorPos = 0;
+    buffer->cursorLine = 0;
+    LineCacheReset(&buffer->meshes, buffer->lines.len);
+    buffer->folds.len = 0;
+    buffer->dirty |= BDirty_All;
+}
@@ -0,0 +1,16 @@
+#ifndef _INGEST_H
+#define _INGEST_H
+
+#include "utils.h"
+#include "buffer.h"
+
+#define INGEST_CHUNK_SIZE MB(1)
+
+// Replaces the buffer contents with the decoded UTF-8 data and rebuilds the
+// line index. Chunks of the input are decoded in parallel and stitched
+// together with a prefix sum over their codepoint and newline counts.
+void IngestBuffer(Buffer *buffer, u8 *data, usize len);
+
+usize CountNewlines(u8 *data, usize len);
+
+#endif // _INGEST_H
@@ -0,0 +1,217 @@
+#include "input.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The keys HandleInput asks about, at most 32.
+static s32 InputKeys[] = {
+    KEY_LEFT, KEY_RIGHT, KEY_UP, KEY_DOWN,
+    KEY_BACKSPACE, KEY_DELETE, KEY_ENTER, KEY_TAB,
+    KEY_LEFT_SUPER, KEY_RIGHT_SUPER, KEY_LEFT_CONTROL, KEY_RIGHT_CONTROL,
+};
+
+#define INPUT_KEY_COUNT (sizeof(InputKeys)/sizeof(*InputKeys))
+
+static u32 KeyBit(s32 key) {
+    for (usize i = 0; i < INPUT_KEY_COUNT; ++i)
+        if (InputKeys[i] == key) return 1u << i;
+    return 0;
+}
+
+b8 InputKeyHit(Input *in, s32 key) {
+    return (in->frame.keyHits & KeyBit(key)) != 0;
+}
+
+b8 InputKeyDown(Input *in, s32 key) {
+    return (in->frame.keysDown & KeyBit(key)) != 0;
+}
+
+s32 InitInput(Input *in, InputMode mode, char *path) {
+    *in = (Input){
+        .mode = mode,
+        .startTime = GetTime(),
+        .frameTimes = Arraylist_f64_Init(TagAlloc(MemTag_UI), 1024),
+        .frameAllocs = Arraylist_usize_Init(TagAlloc(MemTag_UI), 1024),
+    };
+
+    if (mode == InputMode_Record) {
+        in->file = fopen(path, "wb");
+        if (!in->file) return -1;
+
+        InputHeader h = {.magic = INPUT_MAGIC, .version = INPUT_VERSION};
+        fwrite(&h, sizeof(h), 1, in->file);
+    }
+
+    if (mode == InputMode_Replay) {
+        in->replay = MapFile(path);
+
+        InputHeader *h = (InputHeader*)in->replay.data;
+        if (!h || in->replay.size < sizeof(*h) || h->magic != INPUT_MAGIC || h->version != INPUT_VERSION ||
+            (in->replay.size-sizeof(*h)) % sizeof(InputEvent)) {
+            UnmapFile(in->replay);
+            in->replay = (MappedFile){0};
+            return -1;
+        }
+
+        in->events = (InputEvent*)(in->replay.data+sizeof(*h));
+        in->eventCount = (in->replay.size-sizeof(*h)) / sizeof(InputEvent);
+    }
+
+    return 0;
+}
+
+void DeinitInput(Input *in) {
+    if (in->file) fclose(in->file);
+    UnmapFile(in->replay);
+    Arraylist_f64_Deinit(&in->frameTimes);
+    Arraylist_usize_Deinit(&in->frameAllocs);
+}
+
+static void InputSample(Input *in) {
+    InputFrame *f = &in->frame;
+
+    for (usize i = 0; i < INPUT_KEY_COUNT; ++i) {
+        s32 key = InputKeys[i];
+        if (IsKeyPressed(key) || IsKeyPressedRepeat(key)) f->keyHits |= 1u << i;
+        if (IsKeyDown(key)) f->keysDown |= 1u << i;
+    }
+
+    // Same split as HandleInput, the other queue is left for later frames.
+    if (f->keysDown & (KeyBit(KEY_LEFT_SUPER)|KeyBit(KEY_RIGHT_SUPER)|KeyBit(KEY_LEFT_CONTROL)|KeyBit(KEY_RIGHT_CONTROL)))
+        f->key = GetKeyPressed();
+    else
+        f->ch = GetCharPressed();
+
+    f->mouseDown = IsMouseButtonDown(MOUSE_BUTTON_LEFT);
+    if (f->mouseDown) f->mouse = GetMousePosition();
+    f->wheel = GetMouseWheelMoveV();
+
+    // The first frame carries the window size so a replay starts out the same.
+    f->resized = !in->frameIndex || IsWindowResized();
+    if (f->resized) {
+        f->width = GetScreenWidth();
+        f->height = GetScreenHeight();
+    }
+}
+
+static void InputWrite(Input *in, InputKind kind, s32 a, s32 b) {
+    InputEvent e = {
+        .frame = in->frameIndex,
+        .time = GetTime()-in->startTime,
+        .kind = kind,
+        .i = {a, b},
+    };
+    fwrite(&e, sizeof(e), 1, in->file);
+}
+
+static void InputWriteF(Input *in, InputKind kind, f32 a, f32 b) {
+    InputEvent e = {
+        .frame = in->frameIndex,
+        .time = GetTime()-in->startTime,
+        .kind = kind,
+        .f = {a, b},
+    };
+    fwrite(&e, sizeof(e), 1, in->file);
+}
+
+static void InputRecord(Input *in) {
+    InputFrame *f = &in->frame;
+
+    if (f->keyHits) InputWrite(in, Input_KeyHits, f->keyHits, 0);
+    if (f->keysDown) InputWrite(in, Input_KeysDown, f->keysDown, 0);
+    if (f->key) InputWrite(in, Input_Key, f->key, 0);
+    if (f->ch) InputWrite(in, Input_Char, f->ch, 0);
+    if (f->mouseDown) InputWriteF(in, Input_Mouse, f->mouse.x, f->mouse.y);
+    if (f->wheel.x || f->wheel.y) InputWriteF(in, Input_Wheel, f->wheel.x, f->wheel.y);
+    if (f->resized) InputWrite(in, Input_Resize, f->width, f->height);
+}
+
+static void InputPlay(Input *in) {
+    InputFrame *f = &in->frame;
+
+    for (; in->nextEvent < in->eventCount; ++in->nextEvent) {
+        InputEvent e = in->events[in->nextEvent];
+        if (e.frame > in->frameIndex) break;
+
+        switch ((InputKind)e.kind) {
+            case Input_KeyHits: f->keyHits = e.i[0]; break;
+            case Input_KeysDown: f->keysDown = e.i[0]; break;
+            case Input_Key: f->key = e.i[0]; break;
+            case Input_Char: f->ch = e.i[0]; break;
+            case Input_Mouse: {
+                f->mouseDown = true;
+                f->mouse = (Vector2){e.f[0], e.f[1]};
+            } break;
+            case Input_Wheel: f->wheel = (Vector2){e.f[0], e.f[1]}; break;
+            case Input_Resize: {
+                f->resized = true;
+                f->width = e.i[0];
+                f->height = e.i[1];
+            } break;
+        }
+    }
+
+    if (in->nextEvent >= in->eventCount) in->done = true;
+}
+
+void InputPoll(Input *in) {
+    in->frame = (InputFrame){0};
+
+    switch (in->mode) {
+        case InputMode_Live: InputSample(in); break;
+        case InputMode_Record: {
+            InputSample(in);
+            InputRecord(in);
+        } break;
+        case InputMode_Replay: InputPlay(in); break;
+    }
+
+    in->frameIndex++;
+}
+
+void InputFrameDone(Input *in, f64 seconds, usize allocs) {
+    if (in->mode != InputMode_Replay) return;
+    Arraylist_f64_Push(&in->frameTimes, seconds);
+    Arraylist_usize_Push(&in->frameAllocs, allocs);
+}
+
+static s32 CompareF64(const void *a, const void *b) {
+    f64 x = *(f64*)a, y = *(f64*)b;
+    return (x > y) - (x < y);
+}
+
+static s32 CompareUsize(const void *a, const void *b) {
+    usize x = *(usize*)a, y = *(usize*)b;
+    return (x > y) - (x < y);
+}
+
+static usize Percentile(usize count, f64 p) {
+    usize i = (usize)(p*count);
+    return i < count ? i : count-1;
+}
+
+void InputReport(Input *in) {
+    usize count = in->frameTimes.len;
+    if (in->mode != InputMode_Replay || !count) return;
+
+    f64 *times = in->frameTimes.array;
+    usize *allocs = in->frameAllocs.array;
+
+    usize worst = 0, total = 0;
+    for (usize i = 0; i < count; ++i) {
+        if (times[i] > times[worst]) worst = i;
+        total += allocs[i];
+    }
+    f64 worstTime = times[worst];
+
+    qsort(times, count, sizeof(*times), CompareF64);
+    qsort(allocs, count, sizeof(*allocs), CompareUsize);
+
+    printf("replay: %zu frames, %zu events\n", count, in->eventCount);
+    printf("frame ms  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f (frame %zu)\n",
+           times[Percentile(count, 0.5)]*1000, times[Percentile(count, 0.9)]*1000,
+           times[Percentile(count, 0.99)]*1000, worstTime*1000, worst);
+    printf("allocs    p50 %zu  p90 %zu  p99 %zu  max %zu  total %zu\n",
+           allocs[Percentile(count, 0.5)], allocs[Percentile(count, 0.9)],
+           allocs[Percentile(count, 0.99)], allocs[count-1], total);
+}
@@ -0,0 +1,99 @@
+#ifndef _INPUT_H
+#define _INPUT_H
+
+#include "utils.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <raylib.h>
+
+#define INPUT_MAGIC   0x5249434D // "MCIR"
+#define INPUT_VERSION 1
+
+typedef enum _InputMode {
+    InputMode_Live,
+    InputMode_Record,
+    InputMode_Replay,
+} InputMode;
+
+typedef enum _InputKind {
+    Input_KeyHits,  // Bit mask over InputKeys, pressed or repeated.
+    Input_KeysDown, // Bit mask over InputKeys.
+    Input_Key,
+    Input_Char,
+    Input_Mouse,    // Left button held at x, y.
+    Input_Wheel,
+    Input_Resize,
+} InputKind;
+
+// On disk: a header, then events sorted by frame.
+typedef struct _InputHeader {
+    u32 magic;
+    u32 version;
+} InputHeader;
+
+typedef struct _InputEvent {
+    u32 frame;
+    f32 time; // Seconds since the recording started.
+    u32 kind;
+    union {
+        s32 i[2];
+        f32 f[2];
+    };
+} InputEvent;
+
+// Everything HandleInput reads in one frame.
+typedef struct _InputFrame {
+    u32 keyHits;
+    u32 keysDown;
+    s32 key;
+    s32 ch;
+    b8 mouseDown;
+    Vector2 mouse;
+    Vector2 wheel;
+    b8 resized;
+    s32 width;
+    s32 height;
+} InputFrame;
+
+# ifndef INPUT_ARRAYLIST
+# define INPUT_ARRAYLIST
+
+#  define T f64
+#  include "arraylist.h"
+#  define T usize
+#  include "arraylist.h"
+
+# endif
+
+typedef struct _Input {
+    InputMode mode;
+    InputFrame frame;
+    u32 frameIndex;
+    f64 startTime;
+
+    FILE *file; // Recording.
+
+    MappedFile replay;
+    InputEvent *events;
+    usize eventCount;
+    usize nextEvent;
+    b8 done;
+
+    // Per replayed frame.
+    Arraylist_f64 frameTimes;
+    Arraylist_usize frameAllocs;
+} Input;
+
+s32 InitInput(Input *in, InputMode mode, char *path);
+void DeinitInput(Input *in);
+
+// Fills in->frame from the window, or from the recording when replaying.
+void InputPoll(Input *in);
+void InputFrameDone(Input *in, f64 seconds, usize allocs);
+void InputReport(Input *in);
+
+b8 InputKeyHit(Input *in, s32 key);
+b8 InputKeyDown(Input *in, s32 key);
+
+#endif // _INPUT_H
@@ -0,0 +1,56 @@
+#include "jobs.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define MAX_WORKERS 64
+
+typedef struct _ParallelJob {
+    JobProc proc;
+    void *data;
+    usize count;
+    _Atomic usize next;
+} ParallelJob;
+
+usize WorkerCount(void) {
+    static usize count = 0;
+    if (!count) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        count = (n < 1) ? 1 : (n > MAX_WORKERS) ? MAX_WORKERS : n;
+    }
+    return count;
+}
+
+static void *ParallelWorker(void *data) {
+    ParallelJob *job = data;
+
+    for (;;) {
+        usize i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) break;
+        job->proc(job->data, i);
+    }
+
+    return NULL;
+}
+
+void ParallelFor(usize count, JobProc proc, void *data) {
+    ParallelJob job = {
+        .proc = proc,
+        .data = data,
+        .count = count,
+    };
+    atomic_init(&job.next, 0);
+
+    usize workers = WorkerCount();
+    if (workers > count) workers = count;
+
+    pthread_t threads[MAX_WORKERS];
+    usize spawned = 0;
+    for (; spawned+1 < workers; ++spawned)
+        if (pthread_create(threads+spawned, NULL, ParallelWorker, &job)) break;
+
+    ParallelWorker(&job);
+
+    for (usize i = 0; i < spawned; ++i) pthread_join(threads[i], NULL);
+}
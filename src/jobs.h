@@ -0,0 +1,14 @@
+#ifndef _JOBS_H
+#define _JOBS_H
+
+#include "utils.h"
+
+typedef void (*JobProc)(void *data, usize i);
+
+usize WorkerCount(void);
+
+// Runs proc for every i in [0, count) on up to WorkerCount() threads,
+// the calling thread included. Returns when all of them are done.
+void ParallelFor(usize count, JobProc proc, void *data);
+
+#endif // _JOBS_H
@@ -9,6 +9,13 @@
 #define IMPLS
 
 #include "buffer.h"
+#include "compile.h"
+#include "symbols.h"
+#include "grep.h"
+#include "finder.h"
+#include "input.h"
+#include "diff.h"
+#include "ring.h"
 
 #include "utils.h"
 #include "memory.h"
@@ -29,7 +36,14 @@
 #define WIDTH  800
 #define HEIGHT 600
 
-#define BUFFER_COUNT 2
+#define BUFFER_COUNT 4
+// Buffers before COMPILE_BUFFER are for editing.
+#define COMPILE_BUFFER 2
+#define GREP_BUFFER 3
+
+_Static_assert(SYMBOL_BUFFERS == COMPILE_BUFFER, "The symbol index tracks each edit buffer");
+
+#define DEFAULT_COMPILE_COMMAND "make"
 
 
 typedef enum _EditorMode {
@@ -41,178 +55,548 @@ typedef struct _Editor {
     Buffer buffers[BUFFER_COUNT];
 
     usize selectedBuffer;
+    usize editBuffer; // Where compile errors are opened.
 
     f32 width, height;
 
+    Compile compile;
+    char *compileCommand;
+
+    SymbolIndex symbols;
+    Grep grep;
+
+    FileIndex files;
+    Finder finder;
+
+    Input input;
+
+    Diff diff; // Of the two edit buffers.
+
+    b8 showMemStats;
+    usize memStatsVersion;
+
     Alloc tempAlloc;
 } Editor;
 
 void HandleInput(Editor *ed);
+b8 EditorBusy(Editor *ed);
+b8 EditorDiffView(Editor *ed);
+void EditorSelect(Editor *ed, usize i);
+void EditorVisit(Editor *ed, char *path, Diagnostic *d);
+void DrawMemStats(Editor *ed);
+void EditorComplete(Editor *ed);
+void EditorCloseCompletion(Buffer *buffer);
+void EditorFind(Editor *ed);
 
 void UpdateViewport(Editor *ed, f32 width, f32 height);
 
-s32 main() {
+s32 main(s32 argc, char **argv) {
+    InputMode inputMode = InputMode_Live;
+    char *inputPath = NULL;
+
+    if (argc == 3 && !strcmp(argv[1], "--record")) inputMode = InputMode_Record;
+    if (argc == 3 && !strcmp(argv[1], "--replay")) inputMode = InputMode_Replay;
+    if (inputMode != InputMode_Live) inputPath = argv[2];
+
+    b8 replay = inputMode == InputMode_Replay;
+
+    // NOTE(m1cha1s): A replay runs in a hidden window as fast as it can.
+    if (replay) SetConfigFlags(FLAG_WINDOW_HIDDEN);
+
     InitWindow(WIDTH, HEIGHT, "MCoder");
     SetWindowState(FLAG_WINDOW_RESIZABLE);
 
-    SetTargetFPS(60);
+    // NOTE(m1cha1s): Only caps the frame rate while something is changing,
+    // when idle the loop blocks in the event wait.
+    SetTargetFPS(replay ? 0 : 60);
 
     Editor ed = {
         .buffers = {
             InitBuffer(KB(1)),
             InitBuffer(KB(1)),
+            InitBuffer(KB(1)),
+            InitBuffer(KB(1)),
         },
-        .tempAlloc = NewArenaAlloc(SysAlloc, TEMP_ARENA_SIZE),
+        .compile = InitCompile(),
+        .compileCommand = getenv("MCODER_COMPILE"),
+        .finder = InitFinder(),
+        .diff = InitDiff(),
+        .width = WIDTH,
+        .height = HEIGHT,
+        .tempAlloc = NewArenaAlloc(TagAlloc(MemTag_Temp), TEMP_ARENA_SIZE),
     };
+    if (!ed.compileCommand) ed.compileCommand = DEFAULT_COMPILE_COMMAND;
+    ed.buffers[COMPILE_BUFFER].mode = BMode_Compile;
+    ed.buffers[GREP_BUFFER].mode = BMode_Grep;
+
+    InitSymbols(&ed.symbols);
+    SymbolsScanDir(&ed.symbols, ".");
+
+    InitGrep(&ed.grep);
+    InitFileIndex(&ed.files);
+
+    if (InitInput(&ed.input, inputMode, inputPath) < 0) {
+        TraceLog(LOG_ERROR, "INPUT: [%s] Failed to open input recording", inputPath);
+        ed.input.done = true;
+    }
 
     // BufferOpenFile(&buffer, "main.c");
 
-    while (!WindowShouldClose()) {
-        if (IsWindowResized()) UpdateViewport(&ed, GetScreenWidth(), GetScreenHeight());
+    while (!WindowShouldClose() && !ed.input.done) {
+        f64 frameStart = GetTime();
+        usize frameAllocs = MemAllocCount();
+
+        InputPoll(&ed.input);
+        if (ed.input.frame.resized) UpdateViewport(&ed, ed.input.frame.width, ed.input.frame.height);
 
         HandleInput(&ed);
 
-        BeginDrawing();
+        CompileUpdate(&ed.compile, ed.buffers+COMPILE_BUFFER);
+        GrepUpdate(&ed.grep, ed.buffers+GREP_BUFFER);
+
+        // Open prompts poll while the index is still walking, so the list
+        // fills in without waiting for a key.
+        for (usize i=0;i<BUFFER_COUNT;i++)
+            if (ed.buffers[i].mode == BMode_Open) ed.buffers[i].busy = ed.files.building;
+
+        if (ed.buffers[ed.selectedBuffer].mode == BMode_Open && FinderStale(&ed.finder, &ed.files))
+            EditorFind(&ed);
+
+        for (usize i=0;i<BUFFER_COUNT;i++) {
+            Buffer *b = ed.buffers+i;
+            if (!b->edit.active) continue;
+
+            SymbolsSyncBuffer(&ed.symbols, b, i < COMPILE_BUFFER ? i : SYMBOL_NO_BUFFER);
+            // The edit buffers are the two sides of the diff.
+            if (i < COMPILE_BUFFER) DiffSyncBuffer(&ed.diff, i, b);
+            b->edit.active = false;
+        }
+
+        Buffer *buffer = ed.buffers+ed.selectedBuffer;
+        b8 diffView = EditorDiffView(&ed);
+        b8 dirty = diffView ? ed.buffers[0].dirty || ed.buffers[1].dirty : buffer->dirty;
 
-        ClearBackground(BLACK);
+        // NOTE(m1cha1s): raylib can't wake a blocked event wait from another
+        // thread, so while a background job is running we poll instead.
+        b8 busy = EditorBusy(&ed);
+        if (busy || replay) DisableEventWaiting();
+        else EnableEventWaiting();
 
-        DrawBuffer(ed.buffers+ed.selectedBuffer);
+        b8 statsChanged = ed.showMemStats && MemStatsVersion() != ed.memStatsVersion;
 
-        EndDrawing();
+        if (dirty || statsChanged) {
+            BeginDrawing();
+
+            ClearBackground(BLACK);
+
+            if (diffView) DiffDraw(&ed.diff, ed.buffers+0, ed.buffers+1);
+            else DrawBuffer(buffer);
+
+            if (ed.showMemStats) DrawMemStats(&ed);
+
+            EndDrawing();
+
+            ed.memStatsVersion = MemStatsVersion();
+        } else {
+            // Nothing changed, skip the frame and wait for the next event.
+            PollInputEvents();
+            if (busy && !replay) WaitTime(1.0/60.0);
+        }
 
         memClear(ed.tempAlloc);
+
+        InputFrameDone(&ed.input, GetTime()-frameStart, MemAllocCount()-frameAllocs);
     }
 
+    InputReport(&ed.input);
+    DeinitInput(&ed.input);
+
+    DeinitCompile(&ed.compile);
+    DeinitSymbols(&ed.symbols);
+    DeinitGrep(&ed.grep);
+    DeinitFileIndex(&ed.files);
+    DeinitFinder(&ed.finder);
+    DeinitDiff(&ed.diff);
+
     for (usize i=0;i<BUFFER_COUNT;i++)
         DeinitBuffer(&ed.buffers[i]);
 
+    DeleteArenaAlloc(TagAlloc(MemTag_Temp), ed.tempAlloc);
+
     CloseWindow();
+
+    MemReportLeaks();
 }
 
 
 void HandleInput(Editor *ed) {
+    Input *in = &ed->input;
     Buffer *buffer = ed->buffers+ed->selectedBuffer;
+    CompletionPopup *popup = &buffer->completion;
 
-    if (IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT)) {
+    if (InputKeyHit(in, KEY_LEFT)) {
+        EditorCloseCompletion(buffer);
         if (buffer->cursorPos) {
             buffer->cursorPos--;
             BufferFixCursorLineCol(buffer);
+            buffer->dirty |= BDirty_Cursor|BDirty_Status;
         }
     }
-    if (IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT)) {
+    if (InputKeyHit(in, KEY_RIGHT)) {
+        EditorCloseCompletion(buffer);
         if (buffer->cursorPos < buffer->buffer.len) {
             buffer->cursorPos++;
             BufferFixCursorLineCol(buffer);
+            buffer->dirty |= BDirty_Cursor|BDirty_Status;
         }
     }
-    if (IsKeyPressed(KEY_UP) || IsKeyPressedRepeat(KEY_UP)) {
-        if (buffer->cursorLine) {
+    // The open prompt lists its files upwards from the status bar.
+    b8 listUp = buffer->mode == BMode_Open;
+    if (InputKeyHit(in, KEY_UP)) {
+        if (popup->count) {
+            popup->selected = (popup->selected + (listUp ? 1 : popup->count-1)) % popup->count;
+            buffer->dirty |= BDirty_Cursor;
+        } else if (buffer->cursorLine) {
             buffer->cursorLine--;
             BufferFixCursorPos(buffer);
+            buffer->dirty |= BDirty_Cursor|BDirty_Status;
         }
     }
-    if (IsKeyPressed(KEY_DOWN) || IsKeyPressedRepeat(KEY_DOWN)) {
-        if (buffer->cursorLine < buffer->lines.len) {
+    if (InputKeyHit(in, KEY_DOWN)) {
+        if (popup->count) {
+            popup->selected = (popup->selected + (listUp ? popup->count-1 : 1)) % popup->count;
+            buffer->dirty |= BDirty_Cursor;
+        } else if (buffer->cursorLine+1 < buffer->lines.len) {
             buffer->cursorLine++;
             BufferFixCursorPos(buffer);
+            buffer->dirty |= BDirty_Cursor|BDirty_Status;
         }
     }
 
-    if (IsKeyPressed(KEY_BACKSPACE) || IsKeyPressedRepeat(KEY_BACKSPACE)) {
+    if (InputKeyHit(in, KEY_BACKSPACE)) {
         switch (buffer->mode) {
-            case BMode_Norm: BackspaceBuffer(buffer); break;
+            case BMode_Norm: {
+                BackspaceBuffer(buffer);
+                if (popup->count) EditorComplete(ed);
+            } break;
             case BMode_Open: {
                 if (buffer->path.len) buffer->path.len--;
+                EditorFind(ed);
             } break;
+            case BMode_Search: {
+                if (buffer->path.len) buffer->path.len--;
+                buffer->dirty |= BDirty_Status;
+            } break;
+            case BMode_Compile: break;
+            case BMode_Grep: break;
         }
     }
 
-    if (IsKeyPressed(KEY_DELETE) || IsKeyPressedRepeat(KEY_DELETE)) {
-        if (buffer->cursorPos < buffer->buffer.len) buffer->cursorPos++;
-        BackspaceBuffer(buffer);
+    if (buffer->mode == BMode_Norm && InputKeyHit(in, KEY_DELETE)) {
+        DeleteBuffer(buffer);
     }
 
-    if (IsKeyPressed(KEY_ENTER) || IsKeyPressedRepeat(KEY_ENTER)) {
+    if (InputKeyHit(in, KEY_ENTER)) {
         switch (buffer->mode) {
-            case BMode_Norm: InsertBuffer(buffer, '\n'); break;
+            case BMode_Norm: {
+                if (popup->count) {
+                    char *item = BufferCompletionItem(buffer, popup->selected);
+                    for (char *c = item+popup->prefixLen; *c; ++c) InsertBuffer(buffer, *c);
+                    EditorCloseCompletion(buffer);
+                } else {
+                    InsertBuffer(buffer, '\n');
+                }
+            } break;
             case BMode_Open: {
-                buffer->buffer.len = 0;
+                if (popup->count) {
+                    char *item = BufferCompletionItem(buffer, popup->selected);
+                    buffer->path.len = 0;
+                    for (char *c = item; *c; ++c) Arraylist_char_Push(&buffer->path, *c);
+                    popup->count = 0;
+                }
+
+                BufferClear(buffer);
                 BufferOpenFile(buffer);
                 buffer->mode = BMode_Norm;
+                buffer->busy = false;
+                buffer->dirty |= BDirty_All;
+            } break;
+            case BMode_Compile: {
+                Diagnostic *d = CompileDiagnosticAt(&ed->compile, buffer->cursorLine);
+                if (d) EditorVisit(ed, CompileDiagnosticPath(&ed->compile, d), d);
+            } break;
+            case BMode_Search: {
+                GrepStart(&ed->grep, buffer, ".", buffer->path.array, buffer->path.len);
+            } break;
+            case BMode_Grep: {
+                Diagnostic *d = GrepMatchAt(&ed->grep, buffer->cursorLine);
+                if (d) EditorVisit(ed, GrepMatchPath(&ed->grep, d), d);
             } break;
         }
     }
 
-    if (IsKeyPressed(KEY_TAB) || IsKeyPressedRepeat(KEY_TAB)) {
+    if (buffer->mode == BMode_Norm && InputKeyHit(in, KEY_TAB)) {
         s32 spacesToInsert = 4-((buffer->cursorPos - (buffer->lines.array[buffer->cursorLine].start)) % 4);
         for (s32 i=0;i<spacesToInsert;++i) InsertBuffer(buffer, ' ');
     }
 
-    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
-        Vector2 mPos = GetMousePosition();
+    if (in->frame.mouseDown) {
+        EditorCloseCompletion(buffer);
+
+        Vector2 mPos = in->frame.mouse;
 
-        mPos.x = clamp(mPos.x, 0, GetScreenWidth());
-        mPos.y = clamp(mPos.y, 0, GetScreenHeight());
+        // Clicking a pane of the diff moves into that buffer.
+        b8 diffView = EditorDiffView(ed);
+        if (diffView) {
+            usize side = mPos.x >= ed->buffers[1].viewport.x;
+            if (side != ed->selectedBuffer) EditorSelect(ed, side);
+            buffer = ed->buffers+side;
+        }
 
-        printf("Mouse pos { %f %f }\n", mPos.x, mPos.y);
+        mPos.x = clamp(mPos.x-buffer->viewport.x, 0, buffer->viewport.width);
+        mPos.y = clamp(mPos.y-buffer->viewport.y, 0, buffer->viewport.height);
 
         f32 scaleFactor = buffer->fontSize/buffer->font.baseSize;
 
-        usize l = (usize)(mPos.y+buffer->viewLoc) / (buffer->fontSize+buffer->textLineSpacing);
+        usize l;
+        if (diffView) {
+            Buffer *left = ed->buffers+0;
+            usize row = (usize)(mPos.y+ed->diff.viewLoc) / (left->fontSize+left->textLineSpacing);
+            l = DiffLineOfRow(&ed->diff, ed->selectedBuffer, row, buffer->lines.len);
+            BufferRevealLine(buffer, l);
+        } else {
+            usize row = (usize)(mPos.y+buffer->viewLoc) / (buffer->fontSize+buffer->textLineSpacing);
+            usize rowCount = FoldRowCount(&buffer->folds, buffer->lines.len);
+            if (row >= rowCount) row = rowCount-1;
+            l = FoldLineOfRow(&buffer->folds, row);
+        }
         usize c = (usize)mPos.x / ((f32)buffer->font.glyphs[0].advanceX*scaleFactor + buffer->textSpacing);
 
-        buffer->cursorLine = l;
-        buffer->cursorPos = min(buffer->lines.array[buffer->cursorLine].start+c, buffer->lines.array[buffer->cursorLine].end);
+        if (l >= buffer->lines.len) l = buffer->lines.len-1;
+
+        usize pos = min(buffer->lines.array[l].start+c, buffer->lines.array[l].end);
+
+        if (buffer->cursorLine != l || buffer->cursorPos != pos) {
+            buffer->cursorLine = l;
+            buffer->cursorPos = pos;
+            buffer->dirty |= BDirty_Cursor|BDirty_Status;
+        }
     }
 
-    if (IsKeyDown(KEY_LEFT_SUPER) || IsKeyDown(KEY_RIGHT_SUPER) || IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) {
+    if (InputKeyDown(in, KEY_LEFT_SUPER) || InputKeyDown(in, KEY_RIGHT_SUPER) || InputKeyDown(in, KEY_LEFT_CONTROL) || InputKeyDown(in, KEY_RIGHT_CONTROL)) {
         s32 key;
-        if ((key = GetKeyPressed())) {
+        if ((key = in->frame.key)) {
             if (key == KEY_S) {
                 BufferSave(buffer);
             }
             if (key == KEY_EQUAL) {
                 buffer->fontSize+=4;
-                UnloadFont(buffer->font);
                 BufferLoadFont(buffer, buffer->fontSize);
             }
             if (key == KEY_MINUS) {
                 buffer->fontSize-=4;
-                UnloadFont(buffer->font);
                 BufferLoadFont(buffer, buffer->fontSize);
             }
             if (key == KEY_O) {
                 buffer->mode = BMode_Open;
                 buffer->path.len = 0;
+                EditorFind(ed);
 
-                char * msg = tfmt(buffer->tempAlloc, "Specify path");
-                buffer->msg.len=0;
-                for (usize i=0;i<strlen(msg);++i) Arraylist_char_Push(&buffer->msg, msg[i]);
+                BufferSetMsg(buffer, "Find file");
+            }
+            if (key == KEY_B) {
+                if (ed->selectedBuffer < COMPILE_BUFFER) ed->editBuffer = ed->selectedBuffer;
+                CompileStart(&ed->compile, ed->buffers+COMPILE_BUFFER, ed->compileCommand);
+                EditorSelect(ed, COMPILE_BUFFER);
+            }
+            if (key == KEY_E) {
+                Diagnostic *d = CompileNextError(&ed->compile);
+                if (d) EditorVisit(ed, CompileDiagnosticPath(&ed->compile, d), d);
+                else BufferSetMsg(buffer, "No more errors");
+            }
+            if (key == KEY_G) {
+                if (ed->selectedBuffer < COMPILE_BUFFER) ed->editBuffer = ed->selectedBuffer;
+                EditorSelect(ed, GREP_BUFFER);
+
+                Buffer *results = ed->buffers+GREP_BUFFER;
+                results->mode = BMode_Search;
+                results->path.len = 0;
+                BufferSetMsg(results, "Search for (/ for regex)");
+            }
+            if (key == KEY_N) {
+                EditorSelect(ed, (ed->selectedBuffer+1) % BUFFER_COUNT);
+            }
+            if (key == KEY_F && !EditorDiffView(ed)) {
+                EditorCloseCompletion(buffer);
+                BufferToggleFold(buffer);
+            }
+            if (key == KEY_D) {
+                if (ed->diff.active) ed->diff.active = false;
+                else {
+                    if (ed->selectedBuffer >= COMPILE_BUFFER) EditorSelect(ed, ed->editBuffer);
+                    // The diff view shows every line, so the cursor must not skip folds.
+                    for (usize i = 0; i < COMPILE_BUFFER; ++i) ed->buffers[i].folds.len = 0;
+                    DiffStart(&ed->diff, ed->buffers+0, ed->buffers+1);
+                }
+                UpdateViewport(ed, ed->width, ed->height);
+            }
+            if (key == KEY_M) {
+                ed->showMemStats = !ed->showMemStats;
+                buffer->dirty |= BDirty_All;
             }
         }
     } else {
         s32 c;
-        if ((c = GetCharPressed())) {
+        if ((c = in->frame.ch)) {
             switch (buffer->mode) {
-                case BMode_Norm: InsertBuffer(buffer, c); break;
+                case BMode_Norm: {
+                    InsertBuffer(buffer, c);
+                    EditorComplete(ed);
+                } break;
                 case BMode_Open: {
                     Arraylist_char_Push(&buffer->path, c);
+                    EditorFind(ed);
                 } break;
+                case BMode_Search: {
+                    Arraylist_char_Push(&buffer->path, c);
+                    buffer->dirty |= BDirty_Status;
+                } break;
+                case BMode_Compile: break;
+                case BMode_Grep: break;
             }
         }
     }
 
-    Vector2 movement = GetMouseWheelMoveV();
+    Vector2 movement = in->frame.wheel;
+    if (EditorDiffView(ed)) {
+        Buffer *left = ed->buffers+0;
+        f32 diffLoc = ed->diff.viewLoc;
+        ed->diff.viewLoc += -movement.y*100;
+        if (ed->diff.viewLoc > ed->diff.rows.len * (left->fontSize+left->textLineSpacing))
+            ed->diff.viewLoc = ed->diff.rows.len * (left->fontSize+left->textLineSpacing);
+        if (ed->diff.viewLoc < 0) ed->diff.viewLoc = 0;
+        if (ed->diff.viewLoc != diffLoc) {
+            ed->buffers[0].dirty |= BDirty_Text|BDirty_Cursor;
+            ed->buffers[1].dirty |= BDirty_Text|BDirty_Cursor;
+        }
+        return;
+    }
+
+    f32 viewLoc = buffer->viewLoc;
+    usize rowCount = FoldRowCount(&buffer->folds, buffer->lines.len);
     buffer->viewLoc += -movement.y*100;
-    if (buffer->viewLoc > buffer->lines.len * (buffer->fontSize+buffer->textLineSpacing))
-        buffer->viewLoc=buffer->lines.len * (buffer->fontSize+buffer->textLineSpacing);
+    if (buffer->viewLoc > rowCount * (buffer->fontSize+buffer->textLineSpacing))
+        buffer->viewLoc=rowCount * (buffer->fontSize+buffer->textLineSpacing);
     if (buffer->viewLoc < 0) buffer->viewLoc=0;
+    if (buffer->viewLoc != viewLoc) buffer->dirty |= BDirty_Text|BDirty_Cursor;
+}
+
+void EditorSelect(Editor *ed, usize i) {
+    ed->selectedBuffer = i;
+    if (i < COMPILE_BUFFER) ed->editBuffer = i;
+    ed->buffers[i].dirty |= BDirty_All;
+}
+
+// Opens the location of a compile diagnostic or grep match in the edit buffer.
+void EditorVisit(Editor *ed, char *path, Diagnostic *d) {
+    Buffer *buffer = ed->buffers+ed->editBuffer;
+
+    if (buffer->path.len != d->pathLen || strncmp(buffer->path.array, path, d->pathLen)) {
+        buffer->path.len = 0;
+        for (usize i=0;i<d->pathLen;++i) Arraylist_char_Push(&buffer->path, path[i]);
+
+        BufferClear(buffer);
+        buffer->mode = BMode_Norm;
+        buffer->busy = false;
+        if (BufferOpenFile(buffer) < 0) {
+            BufferSetMsg(ed->buffers+ed->selectedBuffer, tfmt(ed->tempAlloc, "%s not found", path));
+            return;
+        }
+    }
+
+    BufferGoto(buffer, d->line ? d->line-1 : 0, d->col ? d->col-1 : 0);
+    EditorSelect(ed, ed->editBuffer);
+}
+
+// Offers completions for the word in front of the cursor.
+void EditorComplete(Editor *ed) {
+    Buffer *buffer = ed->buffers+ed->selectedBuffer;
+
+    usize lineStart = buffer->lines.array[buffer->cursorLine].start;
+    usize start = buffer->cursorPos;
+    while (start > lineStart && buffer->cursorPos-start < SYMBOL_MAX_LEN && IsSymbolChar(buffer->buffer.array[start-1]))
+        start--;
+
+    usize len = buffer->cursorPos-start;
+    if (len < 2 || (buffer->buffer.array[start] >= '0' && buffer->buffer.array[start] <= '9')) {
+        EditorCloseCompletion(buffer);
+        return;
+    }
+
+    char prefix[SYMBOL_MAX_LEN];
+    for (usize i=0;i<len;++i) prefix[i] = (char)buffer->buffer.array[start+i];
+
+    SymbolsComplete(&ed->symbols, prefix, len, &buffer->completion);
+    buffer->dirty |= BDirty_Cursor;
+}
+
+// Fuzzy matches the open prompt against the project files.
+void EditorFind(Editor *ed) {
+    Buffer *buffer = ed->buffers+ed->selectedBuffer;
+    FinderUpdate(&ed->finder, &ed->files, buffer->path.array, buffer->path.len, &buffer->completion);
+    buffer->dirty |= BDirty_All;
+}
+
+void EditorCloseCompletion(Buffer *buffer) {
+    if (!buffer->completion.count) return;
+    buffer->completion.count = 0;
+    buffer->dirty |= BDirty_Text;
+}
+
+void DrawMemStats(Editor *ed) {
+    Buffer *buffer = ed->buffers+ed->selectedBuffer;
+
+    f32 lineHeight = buffer->fontSize + buffer->textLineSpacing;
+    Vector2 pos = {buffer->viewport.x+buffer->viewport.width/2, buffer->viewport.y+lineHeight};
+
+    DrawRectangle(pos.x-buffer->textSpacing, pos.y-buffer->textSpacing,
+                  buffer->viewport.width/2, (MemTag_Count+1)*lineHeight+2*buffer->textSpacing,
+                  (Color){40, 40, 40, 230});
+
+    DrawTextEx(buffer->font, "tag         live       peak   allocs    frees  ovf",
+               pos, buffer->fontSize, buffer->textSpacing, GRAY);
+
+    for (usize i=0;i<MemTag_Count;++i) {
+        MemStats *s = MemTagStats+i;
+        pos.y += lineHeight;
+
+        char *line = tfmt(ed->tempAlloc, "%-10s %7zuK %9zuK %8zu %8zu %4zu",
+                          s->name, atomic_load(&s->live)/KB(1), atomic_load(&s->peak)/KB(1),
+                          atomic_load(&s->allocs), atomic_load(&s->frees), atomic_load(&s->overflows));
+        DrawTextEx(buffer->font, line, pos, buffer->fontSize, buffer->textSpacing, WHITE);
+    }
+}
+
+b8 EditorBusy(Editor *ed) {
+    for (usize i=0;i<BUFFER_COUNT;i++)
+        if (ed->buffers[i].busy) return true;
+    return false;
+}
+
+// The diff is shown while one of its buffers is selected.
+b8 EditorDiffView(Editor *ed) {
+    return ed->diff.active && ed->selectedBuffer < COMPILE_BUFFER;
 }
 
 void UpdateViewport(Editor *ed, f32 width, f32 height) {
+    ed->width = width;
+    ed->height = height;
+
     for (usize i=0;i<BUFFER_COUNT;i++) {
-        UnloadRenderTexture(ed->buffers[i].renderTex);
-        ed->buffers[i].renderTex = LoadRenderTexture(width, height);
+        ed->buffers[i].viewport = (Rectangle){0, 0, width, height};
+        if (ed->diff.active && i < COMPILE_BUFFER)
+            ed->buffers[i].viewport = (Rectangle){i*width/2, 0, width/2, height};
+        ed->buffers[i].dirty |= BDirty_All;
         // TODO(m1cha1s): Add some kind of layouts here. Will need a rework.
     }
 }
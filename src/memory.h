@@ -4,6 +4,8 @@
 #include "utils.h"
 #include "arena.h"
 
+#include <stdatomic.h>
+
 typedef enum _AllocMsg {
     ALLOC_ALLOC,
     ALLOC_FREE,
@@ -22,10 +24,44 @@ void memFree(Alloc alloc, void *p);
 void memClear(Alloc alloc);
 
 
+// Every long lived allocation goes through one of these, so we can tell
+// which subsystem the memory belongs to.
+typedef enum _MemTag {
+    MemTag_Text,
+    MemTag_Lines,
+    MemTag_Font,
+    MemTag_Temp,
+    MemTag_UI,
+    MemTag_Index,
+    MemTag_Count,
+} MemTag;
+
+typedef struct _MemStats {
+    char *name;
+    _Atomic usize live;
+    _Atomic usize peak;
+    _Atomic usize allocs;
+    _Atomic usize frees;
+    _Atomic usize overflows; // Arena overflows of arenas backed by this tag.
+} MemStats;
+
+extern MemStats MemTagStats[MemTag_Count];
+extern Alloc MemTagAllocs[MemTag_Count];
+
+#define TagAlloc(tag) (MemTagAllocs[(tag)])
+
+void *TrackAllocProc(usize size, void *p, AllocMsg msg, void *stats);
+void MemStatsRecord(MemStats *stats, usize size, b8 freed);
+usize MemStatsVersion(void);
+usize MemAllocCount(void);
+usize MemReportLeaks(void);
+
+
 typedef struct _Arena {
     u8 *arena;
     u8 *end;
     usize capacity;
+    MemStats *stats; // Set when the backing allocator is tracked.
 } Arena;
 
 Arena InitArena(Alloc alloc, usize cap);
@@ -56,6 +92,7 @@ void memClear(Alloc alloc) {
 }
 
 #include <stdlib.h>
+#include <stdio.h>
 
 Alloc SysAlloc = (Alloc){
     .proc = SysAllocProc,
@@ -74,6 +111,90 @@ void *SysAllocProc(usize size, void *p, AllocMsg msg, void *_data) {
     return NULL;
 }
 
+MemStats MemTagStats[MemTag_Count] = {
+    [MemTag_Text]  = {.name = "text"},
+    [MemTag_Lines] = {.name = "line index"},
+    [MemTag_Font]  = {.name = "font"},
+    [MemTag_Temp]  = {.name = "temp"},
+    [MemTag_UI]    = {.name = "ui"},
+    [MemTag_Index] = {.name = "index"},
+};
+
+Alloc MemTagAllocs[MemTag_Count] = {
+    [MemTag_Text]  = {.proc = TrackAllocProc, .data = &MemTagStats[MemTag_Text]},
+    [MemTag_Lines] = {.proc = TrackAllocProc, .data = &MemTagStats[MemTag_Lines]},
+    [MemTag_Font]  = {.proc = TrackAllocProc, .data = &MemTagStats[MemTag_Font]},
+    [MemTag_Temp]  = {.proc = TrackAllocProc, .data = &MemTagStats[MemTag_Temp]},
+    [MemTag_UI]    = {.proc = TrackAllocProc, .data = &MemTagStats[MemTag_UI]},
+    [MemTag_Index] = {.proc = TrackAllocProc, .data = &MemTagStats[MemTag_Index]},
+};
+
+void MemStatsRecord(MemStats *stats, usize size, b8 freed) {
+    if (freed) {
+        atomic_fetch_sub(&stats->live, size);
+        atomic_fetch_add(&stats->frees, 1);
+        return;
+    }
+
+    usize live = atomic_fetch_add(&stats->live, size) + size;
+    atomic_fetch_add(&stats->allocs, 1);
+
+    usize peak = atomic_load(&stats->peak);
+    while (live > peak && !atomic_compare_exchange_weak(&stats->peak, &peak, live));
+}
+
+// NOTE(m1cha1s): The size lives in a header in front of the block, 16 bytes
+// to keep the alignment malloc gives us.
+#define TRACK_HEADER 16
+
+void *TrackAllocProc(usize size, void *p, AllocMsg msg, void *stats) {
+    switch(msg) {
+        case ALLOC_ALLOC: {
+            u8 *block = malloc(size+TRACK_HEADER);
+            if (!block) return NULL;
+            *(usize*)block = size;
+            MemStatsRecord(stats, size, false);
+            return block+TRACK_HEADER;
+        } break;
+        case ALLOC_FREE: {
+            if (!p) break;
+            u8 *block = (u8*)p-TRACK_HEADER;
+            MemStatsRecord(stats, *(usize*)block, true);
+            free(block);
+        } break;
+        case ALLOC_CLEAR: {} break;
+    }
+    return NULL;
+}
+
+// Changes whenever anything is allocated or freed, used to redraw the stats panel.
+usize MemStatsVersion(void) {
+    usize v = 0;
+    for (usize i=0;i<MemTag_Count;++i)
+        v += atomic_load(&MemTagStats[i].allocs) + atomic_load(&MemTagStats[i].frees) + atomic_load(&MemTagStats[i].overflows);
+    return v;
+}
+
+usize MemAllocCount(void) {
+    usize count = 0;
+    for (usize i=0;i<MemTag_Count;++i) count += atomic_load(&MemTagStats[i].allocs);
+    return count;
+}
+
+usize MemReportLeaks(void) {
+    usize leaked = 0;
+    for (usize i=0;i<MemTag_Count;++i) {
+        MemStats *s = MemTagStats+i;
+        usize live = atomic_load(&s->live);
+        usize count = atomic_load(&s->allocs) - atomic_load(&s->frees);
+        if (!live && !count) continue;
+
+        printf("LEAK: %s: %zu bytes in %zu allocations (peak %zu bytes)\n", s->name, live, count, atomic_load(&s->peak));
+        leaked += live;
+    }
+    return leaked;
+}
+
 Alloc NewArenaAlloc(Alloc alloc, usize size) {
     Arena *arena = memAlloc(alloc, sizeof(Arena));
     *arena = InitArena(alloc, size);
@@ -106,6 +227,7 @@ inline Arena InitArena(Alloc alloc, usize cap) {
     Arena a = {
         .arena = memAlloc(alloc, cap),
         .capacity = cap,
+        .stats = (alloc.proc == TrackAllocProc) ? alloc.data : NULL,
     };
     a.end = a.arena;
     return a;
@@ -117,7 +239,8 @@ inline void ResetArena(Arena *a) {
 
 void *ArenaAlloc(Arena *a, usize size) {
     if (a->end+size > a->arena+a->capacity) {
-        printf("WARNING: Arena overflow!\n");
+        if (a->stats) atomic_fetch_add(&a->stats->overflows, 1);
+        else printf("WARNING: Arena overflow!\n");
         ResetArena(a);
     }
     
@@ -0,0 +1,90 @@
+#ifndef _RING_H
+#define _RING_H
+
+#include "utils.h"
+#include "memory.h"
+
+#include <stdatomic.h>
+
+// Single producer, single consumer byte ring. cap must be a power of two.
+typedef struct _Ring {
+    u8 *data;
+    usize cap;
+    _Atomic usize head; // Written by the producer.
+    _Atomic usize tail; // Written by the consumer.
+} Ring;
+
+Ring InitRing(Alloc alloc, usize cap);
+usize RingWrite(Ring *r, u8 *data, usize len);
+usize RingRead(Ring *r, u8 *out, usize len);
+usize RingCount(Ring *r);
+void ResetRing(Ring *r);
+void DeinitRing(Alloc alloc, Ring *r);
+
+# if defined(IMPLS)
+
+#include <string.h>
+
+Ring InitRing(Alloc alloc, usize cap) {
+    Ring r = {
+        .data = memAlloc(alloc, cap),
+        .cap = cap,
+    };
+    atomic_init(&r.head, 0);
+    atomic_init(&r.tail, 0);
+    return r;
+}
+
+usize RingWrite(Ring *r, u8 *data, usize len) {
+    usize head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    usize tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+    usize space = r->cap - (head - tail);
+    if (len > space) len = space;
+
+    usize at = head & (r->cap-1);
+    usize first = r->cap - at;
+    if (first > len) first = len;
+
+    memcpy(r->data+at, data, first);
+    memcpy(r->data, data+first, len-first);
+
+    atomic_store_explicit(&r->head, head+len, memory_order_release);
+    return len;
+}
+
+usize RingRead(Ring *r, u8 *out, usize len) {
+    usize tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    usize head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+    usize count = head - tail;
+    if (len > count) len = count;
+
+    usize at = tail & (r->cap-1);
+    usize first = r->cap - at;
+    if (first > len) first = len;
+
+    memcpy(out, r->data+at, first);
+    memcpy(out+first, r->data, len-first);
+
+    atomic_store_explicit(&r->tail, tail+len, memory_order_release);
+    return len;
+}
+
+usize RingCount(Ring *r) {
+    return atomic_load(&r->head) - atomic_load(&r->tail);
+}
+
+// NOTE(m1cha1s): Only safe while no producer is running.
+void ResetRing(Ring *r) {
+    atomic_store(&r->head, 0);
+    atomic_store(&r->tail, 0);
+}
+
+void DeinitRing(Alloc alloc, Ring *r) {
+    memFree(alloc, r->data);
+}
+
+# endif
+
+#endif // _RING_H
@@ -0,0 +1,447 @@
+#include "symbols.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+static u32 HashWord(char *word, usize len) {
+    u32 h = 2166136261u; // FNV-1a
+    for (usize i = 0; i < len; ++i) {
+        h ^= (u8)word[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static b8 SymbolUsed(SymbolEntry *e) {
+    if (e->count > 0) return true;
+    for (usize i = 0; i < SYMBOL_BUFFERS; ++i) if (e->owned[i]) return true;
+    return false;
+}
+
+// Rebuilds the table without the words nothing counts anymore, together
+// with their pool, and doubles it when that does not free enough slots.
+static void SymbolsRehash(SymbolIndex *idx) {
+    usize used = 0;
+    for (usize i = 0; i < idx->slotCap; ++i) used += idx->slots[i].len && SymbolUsed(idx->slots+i);
+
+    usize cap = 4096;
+    while ((used+1)*2 > cap) cap *= 2;
+
+    SymbolEntry *slots = memAlloc(TagAlloc(MemTag_Index), cap*sizeof(SymbolEntry));
+    memset(slots, 0, cap*sizeof(SymbolEntry));
+    Arraylist_char pool = Arraylist_char_Init(TagAlloc(MemTag_Index), max(idx->pool.len, KB(64)));
+
+    for (usize i = 0; i < idx->slotCap; ++i) {
+        SymbolEntry e = idx->slots[i];
+        if (!e.len || !SymbolUsed(&e)) continue;
+
+        usize at = e.hash & (cap-1);
+        while (slots[at].len) at = (at+1) & (cap-1);
+
+        char *word = idx->pool.array+e.offset;
+        e.offset = pool.len;
+        for (usize j = 0; j < e.len; ++j) Arraylist_char_Push(&pool, word[j]);
+        slots[at] = e;
+    }
+
+    memFree(TagAlloc(MemTag_Index), idx->slots);
+    Arraylist_char_Deinit(&idx->pool);
+    idx->slots = slots;
+    idx->slotCap = cap;
+    idx->slotUsed = used;
+    idx->pool = pool;
+}
+
+static void SymbolsAdd(SymbolIndex *idx, char *word, usize len, s32 delta, usize slot) {
+    if ((idx->slotUsed+1)*10 > idx->slotCap*7) SymbolsRehash(idx);
+
+    u32 hash = HashWord(word, len);
+    usize at = hash & (idx->slotCap-1);
+
+    for (; idx->slots[at].len; at = (at+1) & (idx->slotCap-1)) {
+        SymbolEntry *e = idx->slots+at;
+        if (e->hash == hash && e->len == len && !memcmp(idx->pool.array+e->offset, word, len)) {
+            e->count += delta;
+            if (slot < SYMBOL_BUFFERS) e->owned[slot] += delta;
+            return;
+        }
+    }
+
+    if (delta <= 0) return;
+
+    idx->slots[at] = (SymbolEntry){
+        .hash = hash,
+        .offset = idx->pool.len,
+        .len = len,
+        .count = delta,
+    };
+    if (slot < SYMBOL_BUFFERS) idx->slots[at].owned[slot] = delta;
+    idx->slotUsed++;
+
+    for (usize i = 0; i < len; ++i) Arraylist_char_Push(&idx->pool, word[i]);
+}
+
+static b8 IsIdentStart(s32 c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+b8 IsSymbolChar(s32 c) {
+    return IsIdentStart(c) || (c >= '0' && c <= '9');
+}
+
+// Identifiers only, numbers like 0x1F are skipped as a whole.
+#define TOKENIZE(idx, text, len, delta, slot) do {                    \
+    char word[SYMBOL_MAX_LEN];                                        \
+    for (usize i = 0; i < (len);) {                                   \
+        if (!IsSymbolChar((text)[i])) { i++; continue; }                   \
+        usize start = i;                                              \
+        b8 number = !IsIdentStart((text)[i]);                         \
+        while (i < (len) && IsSymbolChar((text)[i])) i++;                  \
+        usize n = i-start;                                            \
+        if (number || n < SYMBOL_MIN_LEN || n > SYMBOL_MAX_LEN) continue; \
+        for (usize j = 0; j < n; ++j) word[j] = (char)(text)[start+j]; \
+        SymbolsAdd((idx), word, n, (delta), (slot));                  \
+    }                                                                 \
+} while (0)
+
+static void TokenizeText(SymbolIndex *idx, s32 *text, usize len, s32 delta, usize slot) {
+    TOKENIZE(idx, text, len, delta, slot);
+}
+
+static void TokenizeBytes(SymbolIndex *idx, u8 *text, usize len, s32 delta, usize slot) {
+    TOKENIZE(idx, text, len, delta, slot);
+}
+
+static b8 IsSourceFile(char *name) {
+    char *ext = strrchr(name, '.');
+    if (!ext) return false;
+
+    char *exts[] = {".c", ".h", ".cc", ".cpp", ".cxx", ".hh", ".hpp"};
+    for (usize i = 0; i < sizeof(exts)/sizeof(*exts); ++i)
+        if (!strcmp(ext, exts[i])) return true;
+    return false;
+}
+
+static u64 FileId(struct stat *st) {
+    return (u64)st->st_ino ^ ((u64)st->st_dev << 48);
+}
+
+static s32 CompareIds(const void *a, const void *b) {
+    u64 x = *(u64*)a, y = *(u64*)b;
+    return (x > y) - (x < y);
+}
+
+static b8 SymbolsScanned(SymbolIndex *idx, char *path) {
+    struct stat st;
+    if (!idx->scannedLen || stat(path, &st)) return false;
+
+    u64 id = FileId(&st);
+    return bsearch(&id, idx->scanned, idx->scannedLen, sizeof(u64), CompareIds) != NULL;
+}
+
+static void ScanDir(SymbolIndex *idx, char *path, s32 depth) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+
+    struct dirent *ent;
+    while (!idx->quit && (ent = readdir(dir))) {
+        if (ent->d_name[0] == '.') continue;
+
+        char child[4096];
+        snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+
+        struct stat st;
+        if (lstat(child, &st)) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < 32) ScanDir(idx, child, depth+1);
+        } else if (S_ISREG(st.st_mode) && st.st_size <= SYMBOL_MAX_FILE && IsSourceFile(ent->d_name)) {
+            MappedFile m = MapFile(child);
+            TokenizeBytes(idx, m.data, m.size, 1, SYMBOL_NO_BUFFER);
+            UnmapFile(m);
+
+            if (idx->scannedLen == idx->scannedCap) {
+                idx->scannedCap = idx->scannedCap ? idx->scannedCap*2 : 256;
+                u64 *scanned = memAlloc(TagAlloc(MemTag_Index), idx->scannedCap*sizeof(u64));
+                if (idx->scannedLen) memcpy(scanned, idx->scanned, idx->scannedLen*sizeof(u64));
+                memFree(TagAlloc(MemTag_Index), idx->scanned);
+                idx->scanned = scanned;
+            }
+            idx->scanned[idx->scannedLen++] = FileId(&st);
+        }
+    }
+
+    closedir(dir);
+
+    if (!depth) qsort(idx->scanned, idx->scannedLen, sizeof(u64), CompareIds);
+}
+
+static _Thread_local char *SortPool;
+
+static s32 CompareEntries(const void *a, const void *b) {
+    return strcmp(SortPool+((SymbolEntry*)a)->offset, SortPool+((SymbolEntry*)b)->offset);
+}
+
+// Builds a sorted copy of the live words and swaps it in for the UI thread.
+static void SymbolsPublish(SymbolIndex *idx) {
+    usize len = 0, poolLen = 0;
+    for (usize i = 0; i < idx->slotCap; ++i) {
+        if (idx->slots[i].count <= 0) continue;
+        len++;
+        poolLen += idx->slots[i].len+1;
+    }
+
+    SymbolTable table = {
+        .entries = memAlloc(TagAlloc(MemTag_Index), (len+1)*sizeof(SymbolEntry)),
+        .len = len,
+        .pool = memAlloc(TagAlloc(MemTag_Index), poolLen+1),
+    };
+
+    usize at = 0, offset = 0;
+    for (usize i = 0; i < idx->slotCap; ++i) {
+        SymbolEntry e = idx->slots[i];
+        if (e.count <= 0) continue;
+
+        memcpy(table.pool+offset, idx->pool.array+e.offset, e.len);
+        table.pool[offset+e.len] = 0;
+        e.offset = offset;
+        offset += e.len+1;
+
+        table.entries[at++] = e;
+    }
+
+    SortPool = table.pool;
+    qsort(table.entries, table.len, sizeof(SymbolEntry), CompareEntries);
+
+    pthread_mutex_lock(&idx->lock);
+    SymbolTable old = idx->table;
+    idx->table = table;
+    pthread_mutex_unlock(&idx->lock);
+
+    memFree(TagAlloc(MemTag_Index), old.entries);
+    memFree(TagAlloc(MemTag_Index), old.pool);
+}
+
+// Drops everything the buffer added and counts its new text, read from the
+// file it was loaded from when it was not copied. A file the directory scan
+// already counted is not counted again, the buffer only keeps how far its
+// text is from the file.
+static void SymbolsResetBuffer(SymbolIndex *idx, SymbolJob *job) {
+    for (usize i = 0; i < idx->slotCap; ++i) {
+        idx->slots[i].count -= idx->slots[i].owned[job->slot];
+        idx->slots[i].owned[job->slot] = 0;
+    }
+
+    TokenizeText(idx, job->new, job->newLen, 1, job->slot);
+
+    if (!*job->path) return;
+
+    // Copied text of a scanned file takes the file's own counts back out.
+    b8 scanned = SymbolsScanned(idx, job->path);
+    s32 delta = 0;
+    if (job->newLen && scanned) delta = -1;
+    else if (!job->newLen && !scanned) delta = 1;
+    if (!delta) return;
+
+    MappedFile m = MapFile(job->path);
+    if (m.size <= SYMBOL_MAX_FILE) TokenizeBytes(idx, m.data, m.size, delta, job->slot);
+    UnmapFile(m);
+}
+
+static void *SymbolsWorker(void *data) {
+    SymbolIndex *idx = data;
+    b8 changed = false;
+
+    pthread_mutex_lock(&idx->lock);
+    while (!idx->quit) {
+        if (!idx->head) {
+            // Publish once the queue is drained, not after every job.
+            if (changed) {
+                pthread_mutex_unlock(&idx->lock);
+                SymbolsPublish(idx);
+                changed = false;
+                pthread_mutex_lock(&idx->lock);
+                continue;
+            }
+
+            pthread_cond_wait(&idx->wake, &idx->lock);
+            continue;
+        }
+
+        SymbolJob *job = idx->head;
+        idx->head = job->next;
+        if (!idx->head) idx->tail = NULL;
+        pthread_mutex_unlock(&idx->lock);
+
+        switch (job->kind) {
+            case SymJob_Scan: ScanDir(idx, job->path, 0); break;
+            case SymJob_Edit: {
+                TokenizeText(idx, job->old, job->oldLen, -1, job->slot);
+                TokenizeText(idx, job->new, job->newLen, 1, job->slot);
+            } break;
+            case SymJob_Reset: SymbolsResetBuffer(idx, job); break;
+        }
+        memFree(TagAlloc(MemTag_Index), job);
+        changed = true;
+
+        pthread_mutex_lock(&idx->lock);
+    }
+    pthread_mutex_unlock(&idx->lock);
+
+    return NULL;
+}
+
+static void SymbolsEnqueue(SymbolIndex *idx, SymbolJob *job) {
+    job->next = NULL;
+
+    pthread_mutex_lock(&idx->lock);
+    if (idx->tail) idx->tail->next = job;
+    else idx->head = job;
+    idx->tail = job;
+    pthread_cond_signal(&idx->wake);
+    pthread_mutex_unlock(&idx->lock);
+}
+
+void InitSymbols(SymbolIndex *idx) {
+    *idx = (SymbolIndex){
+        .pool = Arraylist_char_Init(TagAlloc(MemTag_Index), KB(64)),
+    };
+    SymbolsRehash(idx);
+
+    pthread_mutex_init(&idx->lock, NULL);
+    pthread_cond_init(&idx->wake, NULL);
+    pthread_create(&idx->worker, NULL, SymbolsWorker, idx);
+}
+
+void DeinitSymbols(SymbolIndex *idx) {
+    pthread_mutex_lock(&idx->lock);
+    idx->quit = true;
+    pthread_cond_signal(&idx->wake);
+    pthread_mutex_unlock(&idx->lock);
+
+    pthread_join(idx->worker, NULL);
+
+    while (idx->head) {
+        SymbolJob *job = idx->head;
+        idx->head = job->next;
+        memFree(TagAlloc(MemTag_Index), job);
+    }
+
+    memFree(TagAlloc(MemTag_Index), idx->slots);
+    memFree(TagAlloc(MemTag_Index), idx->scanned);
+    memFree(TagAlloc(MemTag_Index), idx->table.entries);
+    memFree(TagAlloc(MemTag_Index), idx->table.pool);
+    Arraylist_char_Deinit(&idx->pool);
+
+    pthread_mutex_destroy(&idx->lock);
+    pthread_cond_destroy(&idx->wake);
+}
+
+void SymbolsScanDir(SymbolIndex *idx, char *path) {
+    usize len = strlen(path);
+    SymbolJob *job = memAlloc(TagAlloc(MemTag_Index), sizeof(SymbolJob)+len+1);
+
+    *job = (SymbolJob){
+        .kind = SymJob_Scan,
+        .path = (char*)(job+1),
+    };
+    memcpy(job->path, path, len+1);
+
+    SymbolsEnqueue(idx, job);
+}
+
+// Hands the lines edited since the last sync to the worker, which
+// retokenizes only those. A replaced buffer is rescanned from its file on
+// the worker instead. The caller ends the edit.
+void SymbolsSyncBuffer(SymbolIndex *idx, Buffer *buffer, usize slot) {
+    LineEdit *e = &buffer->edit;
+    if (!e->active || slot >= SYMBOL_BUFFERS) return;
+
+    if (e->reset) {
+        // Only edited right after loading, the text has to be copied then.
+        usize newLen = e->resetEdited ? buffer->buffer.len : 0;
+        usize pathLen = buffer->buffer.len ? buffer->path.len : 0;
+
+        SymbolJob *job = memAlloc(TagAlloc(MemTag_Index), sizeof(SymbolJob) + newLen*sizeof(s32) + pathLen+1);
+        *job = (SymbolJob){
+            .kind = SymJob_Reset,
+            .slot = slot,
+            .new = (s32*)(job+1),
+            .newLen = newLen,
+        };
+        job->path = (char*)(job->new+newLen);
+
+        if (newLen) memcpy(job->new, buffer->buffer.array, newLen*sizeof(s32));
+        if (pathLen) memcpy(job->path, buffer->path.array, pathLen);
+        job->path[pathLen] = 0;
+
+        SymbolsEnqueue(idx, job);
+        return;
+    }
+
+    usize start = buffer->lines.array[e->first].start;
+    usize newLen = buffer->lines.array[e->last].end - start;
+
+    SymbolJob *job = memAlloc(TagAlloc(MemTag_Index), sizeof(SymbolJob) + (e->old.len+newLen)*sizeof(s32));
+    *job = (SymbolJob){
+        .kind = SymJob_Edit,
+        .slot = slot,
+        .old = (s32*)(job+1),
+        .oldLen = e->old.len,
+        .newLen = newLen,
+    };
+    job->new = job->old+job->oldLen;
+
+    memcpy(job->old, e->old.array, e->old.len*sizeof(s32));
+    memcpy(job->new, buffer->buffer.array+start, newLen*sizeof(s32));
+
+    SymbolsEnqueue(idx, job);
+}
+
+// Fills the popup with the most frequent words starting with prefix.
+usize SymbolsComplete(SymbolIndex *idx, char *prefix, usize prefixLen, CompletionPopup *out) {
+    out->count = 0;
+    out->selected = 0;
+    out->items.len = 0;
+    out->prefixLen = prefixLen;
+
+    SymbolEntry best[COMPLETION_MAX];
+    usize bestCount = 0;
+
+    pthread_mutex_lock(&idx->lock);
+    SymbolTable *t = &idx->table;
+
+    usize lo = 0, hi = t->len;
+    while (lo < hi) {
+        usize mid = lo + (hi-lo)/2;
+        if (strncmp(t->pool+t->entries[mid].offset, prefix, prefixLen) < 0) lo = mid+1;
+        else hi = mid;
+    }
+
+    for (usize i = lo; i < t->len; ++i) {
+        SymbolEntry e = t->entries[i];
+        if (strncmp(t->pool+e.offset, prefix, prefixLen)) break;
+        if (e.len == prefixLen) continue;
+
+        // Keep best sorted by count, most frequent first.
+        usize at = bestCount;
+        while (at && best[at-1].count < e.count) at--;
+        if (at >= COMPLETION_MAX) continue;
+
+        if (bestCount < COMPLETION_MAX) bestCount++;
+        memmove(best+at+1, best+at, (bestCount-1-at)*sizeof(SymbolEntry));
+        best[at] = e;
+    }
+
+    for (usize i = 0; i < bestCount; ++i) {
+        char *word = t->pool+best[i].offset;
+        for (usize j = 0; j <= best[i].len; ++j) Arraylist_char_Push(&out->items, word[j]);
+    }
+    pthread_mutex_unlock(&idx->lock);
+
+    out->count = bestCount;
+    return bestCount;
+}
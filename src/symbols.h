@@ -0,0 +1,79 @@
+#ifndef _SYMBOLS_H
+#define _SYMBOLS_H
+
+#include "utils.h"
+#include "buffer.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define SYMBOL_MIN_LEN 3
+#define SYMBOL_MAX_LEN 64
+#define SYMBOL_MAX_FILE MB(8) // Larger files in the project are not indexed.
+#define SYMBOL_BUFFERS 2 // Edit buffers whose words are also counted per buffer.
+#define SYMBOL_NO_BUFFER SYMBOL_BUFFERS
+
+typedef struct _SymbolEntry {
+    u32 hash;
+    u32 offset; // Into the owning pool.
+    u32 len;
+    s32 count;
+    s32 owned[SYMBOL_BUFFERS]; // Part of count from each edit buffer, relative to its file when scanned.
+} SymbolEntry;
+
+typedef enum _SymbolJobKind {
+    SymJob_Scan,
+    SymJob_Edit,
+    SymJob_Reset,
+} SymbolJobKind;
+
+typedef struct _SymbolJob {
+    SymbolJobKind kind;
+    struct _SymbolJob *next;
+
+    char *path;  // SymJob_Scan, SymJob_Reset
+    usize slot;  // SymJob_Edit, SymJob_Reset
+    s32 *old;    // SymJob_Edit
+    usize oldLen;
+    s32 *new;    // SymJob_Edit, SymJob_Reset when edited right after loading
+    usize newLen;
+} SymbolJob;
+
+// Sorted, immutable snapshot the UI thread queries.
+typedef struct _SymbolTable {
+    SymbolEntry *entries;
+    usize len;
+    char *pool;
+} SymbolTable;
+
+typedef struct _SymbolIndex {
+    // Owned by the worker thread.
+    SymbolEntry *slots; // Open addressing, unused words are dropped on rehash.
+    usize slotCap;
+    usize slotUsed;
+    Arraylist_char pool;
+    u64 *scanned; // Sorted file ids of the files the directory scan counted.
+    usize scannedLen;
+    usize scannedCap;
+
+    // Guarded by lock.
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    SymbolJob *head;
+    SymbolJob *tail;
+    SymbolTable table;
+    _Atomic b8 quit;
+
+    pthread_t worker;
+} SymbolIndex;
+
+void InitSymbols(SymbolIndex *idx);
+void DeinitSymbols(SymbolIndex *idx);
+
+void SymbolsScanDir(SymbolIndex *idx, char *path);
+void SymbolsSyncBuffer(SymbolIndex *idx, Buffer *buffer, usize slot);
+usize SymbolsComplete(SymbolIndex *idx, char *prefix, usize prefixLen, CompletionPopup *out);
+
+b8 IsSymbolChar(s32 c);
+
+#endif // _SYMBOLS_H
@@ -0,0 +1,129 @@
+#include "textrender.h"
+
+#include <rlgl.h>
+#include <math.h>
+
+static f32 IndexAdvance(Font font, s32 index, f32 scaleFactor, f32 textSpacing) {
+    if (font.glyphs[index].advanceX == 0)
+        return (f32)font.recs[index].width*scaleFactor + textSpacing;
+
+    return (f32)font.glyphs[index].advanceX*scaleFactor + textSpacing;
+}
+
+f32 GlyphAdvance(Font font, f32 fontSize, f32 textSpacing, s32 codepoint) {
+    return IndexAdvance(font, GetGlyphIndex(font, codepoint), fontSize/font.baseSize, textSpacing);
+}
+
+void LineMeshBuild(LineMesh *mesh, Font font, f32 fontSize, f32 textSpacing, s32 *text, usize len) {
+    if (!mesh->quads.cap) mesh->quads = Arraylist_GlyphQuad_Init(TagAlloc(MemTag_UI), 16);
+    mesh->quads.len = 0;
+
+    f32 scaleFactor = fontSize/font.baseSize;
+    f32 padding = font.glyphPadding;
+    f32 texWidth = font.texture.width;
+    f32 texHeight = font.texture.height;
+
+    f32 x = 0;
+    for (usize i = 0; i < len; ++i) {
+        s32 codepoint = text[i];
+        s32 index = GetGlyphIndex(font, codepoint);
+
+        if ((codepoint != ' ') && (codepoint != '\t')) {
+            Rectangle rec = font.recs[index];
+            // Same placement as DrawTextCodepoint, but computed once per line edit.
+            Arraylist_GlyphQuad_Push(&mesh->quads, (GlyphQuad){
+                .dst = {
+                    floor(x) + (font.glyphs[index].offsetX - padding)*scaleFactor,
+                    (font.glyphs[index].offsetY - padding)*scaleFactor,
+                    (rec.width + 2*padding)*scaleFactor,
+                    (rec.height + 2*padding)*scaleFactor,
+                },
+                .src = {
+                    (rec.x - padding)/texWidth,
+                    (rec.y - padding)/texHeight,
+                    (rec.width + 2*padding)/texWidth,
+                    (rec.height + 2*padding)/texHeight,
+                },
+            });
+        }
+
+        x += IndexAdvance(font, index, scaleFactor, textSpacing);
+    }
+
+    mesh->width = x;
+    mesh->built = true;
+}
+
+void LineMeshDraw(LineMesh *mesh, Texture2D atlas, Vector2 origin, f32 maxX, Color tint) {
+    if (!mesh->quads.len) return;
+
+    rlCheckRenderBatchLimit(4*mesh->quads.len);
+
+    rlSetTexture(atlas.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(tint.r, tint.g, tint.b, tint.a);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+
+    for (usize i = 0; i < mesh->quads.len; ++i) {
+        GlyphQuad *q = mesh->quads.array+i;
+
+        f32 x0 = origin.x + q->dst.x;
+        f32 y0 = origin.y + q->dst.y;
+        f32 x1 = x0 + q->dst.width;
+        f32 y1 = y0 + q->dst.height;
+
+        // Quads are sorted by x, nothing further right is visible. Lines
+        // start at the viewport's left edge, so that is origin.x.
+        if (x0 > maxX) break;
+        if (x1 < origin.x) continue;
+
+        f32 u0 = q->src.x;
+        f32 v0 = q->src.y;
+        f32 u1 = u0 + q->src.width;
+        f32 v1 = v0 + q->src.height;
+
+        rlTexCoord2f(u0, v0); rlVertex2f(x0, y0);
+        rlTexCoord2f(u0, v1); rlVertex2f(x0, y1);
+        rlTexCoord2f(u1, v1); rlVertex2f(x1, y1);
+        rlTexCoord2f(u1, v0); rlVertex2f(x1, y0);
+    }
+
+    rlEnd();
+    rlSetTexture(0);
+}
+
+void LineMeshDeinit(LineMesh *mesh) {
+    if (mesh->quads.cap) Arraylist_GlyphQuad_Deinit(&mesh->quads);
+    *mesh = (LineMesh){0};
+}
+
+void LineCacheReset(Arraylist_LineMesh *cache, usize lineCount) {
+    for (usize i = 0; i < cache->len; ++i) LineMeshDeinit(cache->array+i);
+    cache->len = 0;
+
+    for (usize i = 0; i < lineCount; ++i) Arraylist_LineMesh_Push(cache, (LineMesh){0});
+}
+
+void LineCacheInsert(Arraylist_LineMesh *cache, usize line) {
+    Arraylist_LineMesh_Insert(cache, (LineMesh){0}, line);
+}
+
+void LineCacheRemove(Arraylist_LineMesh *cache, usize line) {
+    if (line >= cache->len) return;
+
+    LineMeshDeinit(cache->array+line);
+    Arraylist_LineMesh_Remove(cache, line);
+}
+
+void LineCacheInvalidate(Arraylist_LineMesh *cache, usize line) {
+    if (line < cache->len) cache->array[line].built = false;
+}
+
+void LineCacheInvalidateAll(Arraylist_LineMesh *cache) {
+    for (usize i = 0; i < cache->len; ++i) cache->array[i].built = false;
+}
+
+void LineCacheDeinit(Arraylist_LineMesh *cache) {
+    for (usize i = 0; i < cache->len; ++i) LineMeshDeinit(cache->array+i);
+    Arraylist_LineMesh_Deinit(cache);
+}
@@ -0,0 +1,39 @@
+#ifndef _TEXTRENDER_H
+#define _TEXTRENDER_H
+
+#include "utils.h"
+
+#include <raylib.h>
+
+typedef struct _GlyphQuad {
+    Rectangle dst; // Relative to the line origin.
+    Rectangle src; // Normalized atlas coordinates.
+} GlyphQuad;
+
+#define T GlyphQuad
+#include "arraylist.h"
+
+// NOTE(m1cha1s): A zeroed LineMesh is a valid, not yet built mesh.
+typedef struct _LineMesh {
+    Arraylist_GlyphQuad quads;
+    f32 width;
+    b8 built;
+} LineMesh;
+
+#define T LineMesh
+#include "arraylist.h"
+
+f32 GlyphAdvance(Font font, f32 fontSize, f32 textSpacing, s32 codepoint);
+
+void LineMeshBuild(LineMesh *mesh, Font font, f32 fontSize, f32 textSpacing, s32 *text, usize len);
+void LineMeshDraw(LineMesh *mesh, Texture2D atlas, Vector2 origin, f32 maxX, Color tint);
+void LineMeshDeinit(LineMesh *mesh);
+
+void LineCacheReset(Arraylist_LineMesh *cache, usize lineCount);
+void LineCacheInsert(Arraylist_LineMesh *cache, usize line);
+void LineCacheRemove(Arraylist_LineMesh *cache, usize line);
+void LineCacheInvalidate(Arraylist_LineMesh *cache, usize line);
+void LineCacheInvalidateAll(Arraylist_LineMesh *cache);
+void LineCacheDeinit(Arraylist_LineMesh *cache);
+
+#endif // _TEXTRENDER_H
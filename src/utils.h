@@ -5,7 +5,9 @@
 
 typedef unsigned char u8;
 typedef unsigned int u32;
+typedef unsigned long long u64;
 typedef int s32;
+typedef long long s64;
 
 typedef size_t usize;
 // typedef signed size_t ssize;
@@ -38,6 +40,16 @@ char *tfmt(Alloc alloc, const char * format, ...);
 
 s32 DrawFText(Alloc alloc, u32 x, u32 y, u32 size, Color c, const char * format, ...);
 
+// Read only mapping of a whole file, data is NULL when the file can't be
+// opened or is empty.
+typedef struct _MappedFile {
+    u8 *data;
+    usize size;
+} MappedFile;
+
+MappedFile MapFile(char *path);
+void UnmapFile(MappedFile m);
+
 #if defined(IMPLS)
 
 #include <stdarg.h>
@@ -78,6 +90,34 @@ s32 DrawFText(Alloc alloc, u32 x, u32 y, u32 size, Color c, const char * format,
     DrawText(buffer, x, y, size, c);
 }
 
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile MapFile(char *path) {
+    MappedFile m = {0};
+
+    s32 fd = open(path, O_RDONLY);
+    if (fd < 0) return m;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            m.data = p;
+            m.size = st.st_size;
+        }
+    }
+
+    close(fd);
+    return m;
+}
+
+void UnmapFile(MappedFile m) {
+    if (m.data) munmap(m.data, m.size);
+}
+
 #endif
 
 #endif
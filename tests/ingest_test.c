@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <string.h>
+
+#define IMPLS
+
+#include "buffer.h"
+#include "compile.h"
+#include "symbols.h"
+#include "grep.h"
+#include "finder.h"
+#include "input.h"
+#include "diff.h"
+#include "ring.h"
+#include "ingest.h"
+
+#include "utils.h"
+#include "memory.h"
+
+# ifndef ARRAYLIST
+# define ARRAYLIST
+
+#  define T s32
+#  include "arraylist.h"
+#  define T char
+#  include "arraylist.h"
+
+# endif
+
+static s32 failed;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failed++; } } while (0)
+
+static Buffer TestBuffer(void) {
+    Buffer b = {
+        .buffer = Arraylist_s32_Init(TagAlloc(MemTag_Text), 4),
+        .lines = Arraylist_Line_Init(TagAlloc(MemTag_Lines), 4),
+        .meshes = Arraylist_LineMesh_Init(TagAlloc(MemTag_UI), 4),
+        .folds = Arraylist_Fold_Init(TagAlloc(MemTag_Lines), 4),
+    };
+    return b;
+}
+
+static void TestIngest(char *name, u8 *data, usize len, s32 *want, usize wantLen, usize wantLines) {
+    Buffer b = TestBuffer();
+    IngestBuffer(&b, data, len);
+
+    if (b.buffer.len != wantLen || memcmp(b.buffer.array, want, wantLen*sizeof(s32))) {
+        printf("%s: decoded text differs\n", name);
+        failed++;
+    }
+    if (b.lines.len != wantLines) {
+        printf("%s: %zu lines, want %zu\n", name, b.lines.len, wantLines);
+        failed++;
+    }
+    CHECK(b.lines.array[0].start == 0);
+    CHECK(b.lines.array[b.lines.len-1].end == b.buffer.len);
+}
+
+int main(void) {
+    // Overlong '\n' must not decode to a newline the count pass missed.
+    u8 overlong[] = {'a', 0xC0, 0x8A, 'b', '\n', 'c'};
+    s32 overlongWant[] = {'a', '?', '?', 'b', '\n', 'c'};
+    TestIngest("overlong", overlong, sizeof(overlong), overlongWant, 6, 2);
+
+    u8 overlong3[] = {0xE0, 0x80, 0x8A, '\n'};
+    s32 overlong3Want[] = {'?', '?', '?', '\n'};
+    TestIngest("overlong3", overlong3, sizeof(overlong3), overlong3Want, 4, 2);
+
+    u8 surrogate[] = {0xED, 0xA0, 0x80, 'x'};
+    s32 surrogateWant[] = {'?', '?', '?', 'x'};
+    TestIngest("surrogate", surrogate, sizeof(surrogate), surrogateWant, 4, 1);
+
+    u8 big[] = {0xF4, 0x90, 0x80, 0x80, 0xF0, 0x80, 0x80, 0x8A};
+    s32 bigWant[] = {'?', '?', '?', '?', '?', '?', '?', '?'};
+    TestIngest("big", big, sizeof(big), bigWant, 8, 1);
+
+    u8 valid[] = {0xC3, 0xA9, '\n', 0xE2, 0x82, 0xAC, '\n', 0xF0, 0x9F, 0x98, 0x80, 0xFF};
+    s32 validWant[] = {0xE9, '\n', 0x20AC, '\n', 0x1F600, '?'};
+    TestIngest("valid", valid, sizeof(valid), validWant, 6, 3);
+
+    // Every chunk full of overlong newlines.
+    usize len = 2*INGEST_CHUNK_SIZE+7;
+    u8 *data = memAlloc(TagAlloc(MemTag_Temp), len);
+    s32 *want = memAlloc(TagAlloc(MemTag_Temp), len*sizeof(s32));
+    for (usize i = 0; i < len; ++i) {
+        data[i] = i % 3 == 2 ? '\n' : i % 3 ? 0x8A : 0xC0;
+        want[i] = i % 3 == 2 ? '\n' : '?';
+    }
+    TestIngest("chunks", data, len, want, len, len/3+1);
+
+    if (!failed) printf("ok\n");
+    return failed != 0;
+}